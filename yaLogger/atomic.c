@@ -2,15 +2,113 @@
 
 //////////////////////////////////////////////////////////////////
 // Atomic loggers functions
-inline void common_lgg_print(FILE *ostream, lgg_time *time, log_lvl level, uint16_t line, const char *file, const char *func, const char *fmt, va_list argptr) {
+
+const char lgg_msg_fmt[] = "%.*s";
+
+// Call site part of log line, " {file:line} {func()} ", is the same for every message from one LOG,
+// so it's rendered once and cached per thread. Key is file and func pointers, which are literals in LOG.
+// print__log takes any strings though, so on hit their contents are compared with cached ones too
+#define CALL_SITE_CACHE_SIZE 64
+#define CALL_SITE_MAX_LEN 128
+
+typedef struct {
+    const char *file;
+    const char *func;
+    uint16_t line;
+    uint16_t len;
+    uint8_t file_len;
+    uint8_t func_len;
+    char str[CALL_SITE_MAX_LEN];
+} call_site;
+
+static p_thread_local call_site call_site_cache[CALL_SITE_CACHE_SIZE];
+
+static inline char *append_str(char *dst, const char *end, const char *src, size_t len) {
+    len = MIN(len, (size_t)(end - dst));
+    memcpy(dst, src, len);
+    return dst + len;
+}
+
+static inline char *append_uint(char *dst, const char *end, unsigned value) {
+    char digits[10];
+    int n = 0;
+
+    do {
+        digits[sizeof(digits) - ++n] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    return append_str(dst, end, digits + sizeof(digits) - n, n);
+}
+
+static char *append_call_site(char *dst, const char *end, uint16_t line, const char *file, const char *func) {
+    uintptr_t hash = ((uintptr_t)file >> 3) ^ ((uintptr_t)func >> 3) ^ (line * 2654435761u);
+    call_site *site = &call_site_cache[hash % CALL_SITE_CACHE_SIZE];
+    char buf[CALL_SITE_MAX_LEN];
+    char *ptr;
+    size_t file_len, func_len;
+
+    if (site->file == file && site->func == func && site->line == line && site->len > 0 &&
+        memcmp(site->str + 2, file, site->file_len) == 0 && file[site->file_len] == '\0' &&
+        memcmp(site->str + site->len - site->func_len - 4, func, site->func_len) == 0 && func[site->func_len] == '\0')
+    {
+        return append_str(dst, end, site->str, site->len);
+    }
+
+    file_len = strlen(file);
+    func_len = strlen(func);
+    if (file_len + func_len + 16 > CALL_SITE_MAX_LEN) {
+        // Too long to be cached
+        ptr = append_str(dst, end, " {", 2);
+        ptr = append_str(ptr, end, file, file_len);
+        ptr = append_str(ptr, end, ":", 1);
+        ptr = append_uint(ptr, end, line);
+        ptr = append_str(ptr, end, "} {", 3);
+        ptr = append_str(ptr, end, func, func_len);
+        return append_str(ptr, end, "()} ", 4);
+    }
+
+    ptr = append_str(buf, buf + CALL_SITE_MAX_LEN, " {", 2);
+    ptr = append_str(ptr, buf + CALL_SITE_MAX_LEN, file, file_len);
+    ptr = append_str(ptr, buf + CALL_SITE_MAX_LEN, ":", 1);
+    ptr = append_uint(ptr, buf + CALL_SITE_MAX_LEN, line);
+    ptr = append_str(ptr, buf + CALL_SITE_MAX_LEN, "} {", 3);
+    ptr = append_str(ptr, buf + CALL_SITE_MAX_LEN, func, func_len);
+    ptr = append_str(ptr, buf + CALL_SITE_MAX_LEN, "()} ", 4);
+
+    site->file = file;
+    site->func = func;
+    site->line = line;
+    site->len = (uint16_t)(ptr - buf);
+    site->file_len = (uint8_t)file_len;
+    site->func_len = (uint8_t)func_len;
+    memcpy(site->str, buf, site->len);
+    return append_str(dst, end, site->str, site->len);
+}
+
+// Assemble log line into out, which must hold MAX_LOG_RECORD_LEN bytes. Returns line length.
+// Format is "<time> <level_tag> {<file>:<line>} {<func>()} [<context>] <message> [stack=<id>]\n", assembled with plain copies.
+// Context part is present only if calling thread has one, stack reference only if its stack was captured
+inline int common_lgg_format(char *out, const char *level_tag, lgg_time *time, uint16_t line, const char *file, const char *func, const char *fmt, va_list argptr) {
     char msg_buf[MAX_LOG_LINE_LEN];
-    static const char *warn = "... !!! WARNING !!! Message was truncated!";
+    const char *msg = msg_buf;
+    static const char warn[] = "... !!! WARNING !!! Message was truncated!";
+    const char *end = out + MAX_LOG_RECORD_LEN - 1; // Place for line ending is always reserved
+    const char *context;
+    size_t context_len;
+    char stack_ref[LOG_STACK_REF_LEN];
     int required_len;
-	char *timeline;
-	char *loglvl;
+    char *ptr;
 
     // Assemble user formated string
-    if (argptr != NULL) {
+    if (fmt == lgg_msg_fmt && argptr != NULL) {
+        // Message formatted by caller (print__log__str) is copied as is, with null characters it may have
+        va_list args_copy;
+        va_copy(args_copy, argptr);
+        required_len = va_arg(args_copy, int);
+        msg = va_arg(args_copy, const char *);
+        va_end(args_copy);
+    }
+    else if (argptr != NULL) {
     	va_list args_copy;
     	va_copy(args_copy, argptr); // Copy just in case if pointed-to structure will be changed
     	required_len = vsnprintf(msg_buf, MAX_LOG_LINE_LEN, fmt, args_copy);
@@ -19,20 +117,302 @@ inline void common_lgg_print(FILE *ostream, lgg_time *time, log_lvl level, uint1
     else
     	required_len = snprintf(msg_buf, MAX_LOG_LINE_LEN, fmt);
 
-    timeline = get_datetime_str(time);
-    loglvl = log_level_to_str(level);
-    // And then print it in logger wrapped format
+    // And then wrap it in logger format
     // TODO: Make file, line and func optional
-    fprintf(ostream, "%s [%-5s] {%s:%d} {%s()} %s%s\n", timeline, loglvl, file, line, func, msg_buf, required_len >= MAX_LOG_LINE_LEN ? warn : "");
+    ptr = out + format_datetime(out, time);
+    ptr = append_str(ptr, end, " ", 1);
+    ptr = append_str(ptr, end, level_tag, strlen(level_tag));
+    ptr = append_call_site(ptr, end, line, file, func);
+    context = log_context_fragment(&context_len);
+    ptr = append_str(ptr, end, context, context_len);
+    ptr = append_str(ptr, end, msg, CLAMP_MAX(CLAMP_MIN(required_len, 0), MAX_LOG_LINE_LEN - 1));
+    if (required_len >= MAX_LOG_LINE_LEN)
+        ptr = append_str(ptr, end, warn, sizeof(warn) - 1);
+    ptr = append_str(ptr, end, stack_ref, log_stack_ref(stack_ref));
+    *ptr++ = '\n';
+
+    return (int)(ptr - out);
+}
+
+inline int common_lgg_print(FILE *ostream, lgg_time *time, log_lvl level, uint16_t line, const char *file, const char *func, const char *fmt, va_list argptr) {
+    char out[MAX_LOG_RECORD_LEN];
+    int len = common_lgg_format(out, log_level_tags[MIN(level, UNKNOWN_L)], time, line, file, func, fmt, argptr);
+
+    return (int)fwrite(out, 1, len, ostream);
 }
 
 FILE *file_lgg_output = NULL; // Output file handle
+char file_lgg_path[P_MAX_PATH] = ""; // Path of output file, other sinks name their files after it
+
+// Per-thread mode: each thread writes <name>.<n>.t<tid>.log without any synchronization.
+// Thread that got tid of finished one writes <name>.<n>.t<tid>-<k>.log instead
+typedef struct {
+    FILE *output;
+    lgg_index index;
+    uint64_t offset;
+    log_stack_set stacks;
+} lgg_thread_file;
+
+static bool file_lgg_per_thread = false;
+static int file_lgg_write_index = 0;
+static unsigned file_lgg_generation = 0;        // Changes on every init and close, so threads reopen their files
+static lgg_thread_file **thread_files = NULL;   // Files of running threads, to close them. Protected by lock
+static p_mutex thread_files_lock = P_MUTEX_INITIALIZER;
+// File of finished thread is closed by key destructor
+static p_thread_key thread_file_key;
+static bool thread_file_key_created = false;
+static p_thread_local lgg_thread_file *thread_file = NULL;
+static p_thread_local unsigned thread_file_generation = 0;
+lgg_index file_lgg_index = { NULL }; // Sidecar index of output file, inactive if output is NULL
+static uint64_t file_lgg_offset = 0; // Bytes written to output file
+static log_stack_set file_lgg_stacks = { NULL }; // Stacks whose text is already in output file
+
+// Console logger writes to stdout descriptor directly from its own buffer instead of stdio,
+// so it can check whether output is ready and never make caller wait on slow pipe.
+// Only blocking output to pipe or file goes through stdout stream, which keeps it in order with
+// printf of the process and is flushed at exit. Own buffer is flushed at exit too
+#define CONSOLE_LGG_CHUNK 4096 // Not more than PIPE_BUF, so write to ready pipe doesn't block
+#define CONSOLE_LGG_FLUSH_SECONDS 1 // Buffered lines older than this are flushed with the next line
+
+static const char *console_color_tags[UNKNOWN_L + 1] = {
+    "\x1b[1;35m[FATAL]\x1b[0m",
+    "\x1b[1;31m[ALERT]\x1b[0m",
+    "\x1b[1;31m[CRIT ]\x1b[0m",
+    "\x1b[31m[ERROR]\x1b[0m",
+    "\x1b[33m[WARN ]\x1b[0m",
+    "\x1b[36m[NOTE ]\x1b[0m",
+    "\x1b[32m[INFO ]\x1b[0m",
+    "\x1b[90m[DEBUG]\x1b[0m",
+    "[N/S  ]",
+    "[UNK  ]"
+};
+
+static struct {
+    int flags;
+    const char **out_tags; // Level tags for stdout, plain or colored
+    const char **err_tags; // Level tags for stderr, plain or colored
+    bool buffered;         // Hold lines until buffer is full, ERROR line or time bound. Set on init if stdout isn't TTY
+    bool use_stdio;        // Buffered blocking output goes through stdout stream, in order with the rest of process output
+    time_t buffered_since; // Time of the oldest line in buffer
+    bool exit_flush;       // Flush at exit is registered
+    bool partial;          // Line at the start of buffer is partly written already
+    uint64_t dropped;      // Lines dropped since last report
+    size_t len;
+    char buf[CONSOLE_LGG_BUF_SIZE];
+    log_stack_set stacks;  // Stacks whose text is already printed
+    p_mutex lock;
+} console_lgg = { 0, log_level_tags, log_level_tags, false, false, 0, false, false, 0, 0, { 0 }, { NULL }, P_MUTEX_INITIALIZER };
+
+static void console_write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        int written = (int)p_write(fd, data, MIN(len, CONSOLE_LGG_CHUNK));
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return;
+        data += written;
+        len -= written;
+    }
+}
+
+static bool console_writable(int fd) {
+#ifdef OS_LINUX
+    struct pollfd pfd = { fd, POLLOUT, 0 };
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLOUT);
+#else
+    // There's no cheap readiness check for console handles and pipes, so writes may block
+    return true;
+#endif
+}
+
+// Write rest of partly written line, so nothing else gets into the middle of it. Call under lock
+static void console_finish_line(void) {
+    const char *eol;
+    size_t len;
+
+    if (console_lgg.use_stdio) {
+        // Stream may have written part of its buffer
+        fflush(stdout);
+        return;
+    }
+    if (!console_lgg.partial)
+        return;
+    eol = memchr(console_lgg.buf, '\n', console_lgg.len);
+    len = eol != NULL ? eol - console_lgg.buf + 1 : console_lgg.len;
+    console_write_all(p_fileno(stdout), console_lgg.buf, len);
+    memmove(console_lgg.buf, console_lgg.buf + len, console_lgg.len - len);
+    console_lgg.len -= len;
+    console_lgg.partial = false;
+}
+
+// Write out buffered lines. Without block it stops as soon as stdout can't take more,
+// and writes whole lines only, unless write itself is short. Call under lock
+static void console_flush(bool block) {
+    int fd = p_fileno(stdout);
+    size_t done = 0;
+
+    if (console_lgg.use_stdio) {
+        fflush(stdout);
+        return;
+    }
+    if (block) {
+        // What process printed to stdout through stdio goes before lines that are written now
+        console_finish_line();
+        fflush(stdout);
+        console_write_all(fd, console_lgg.buf, console_lgg.len);
+        done = console_lgg.len;
+    } else {
+        while (done < console_lgg.len && console_writable(fd)) {
+            size_t len = MIN(console_lgg.len - done, CONSOLE_LGG_CHUNK);
+            size_t whole = len;
+            int written;
+
+            // Every line fits into chunk, so there's at least one line ending in it
+            while (whole > 0 && console_lgg.buf[done + whole - 1] != '\n')
+                whole--;
+            written = (int)p_write(fd, console_lgg.buf + done, whole > 0 ? whole : len);
+            if (written <= 0)
+                break;
+            done += written;
+        }
+        if (done > 0)
+            console_lgg.partial = console_lgg.buf[done - 1] != '\n';
+    }
+
+    memmove(console_lgg.buf, console_lgg.buf + done, console_lgg.len - done);
+    console_lgg.len -= done;
+}
+
+// Call under lock
+static void console_append(const char *data, size_t len) {
+    bool block = !(console_lgg.flags & CONSOLE_NONBLOCK);
+
+    if (console_lgg.use_stdio) {
+        fwrite(data, 1, len, stdout);
+        return;
+    }
+    if (console_lgg.len + len > CONSOLE_LGG_BUF_SIZE)
+        console_flush(block);
+    if (console_lgg.len + len > CONSOLE_LGG_BUF_SIZE) {
+        console_lgg.dropped++;
+        return;
+    }
+    memcpy(console_lgg.buf + console_lgg.len, data, len);
+    console_lgg.len += len;
+}
+
+static void console_report_dropped(void) {
+    char notice[64];
+    int len;
+
+    if (console_lgg.dropped == 0)
+        return;
+    len = snprintf(notice, sizeof(notice), "... %llu console lines were dropped\n", (unsigned long long)console_lgg.dropped);
+    if (console_lgg.len + len <= CONSOLE_LGG_BUF_SIZE) {
+        console_lgg.dropped = 0;
+        console_append(notice, len);
+    }
+}
+
+static void console_enable_colors(int fd) {
+#ifdef OS_WINDOWS
+    // Windows console interprets ANSI sequences only in virtual terminal mode
+    HANDLE handle = (HANDLE)_get_osfhandle(fd);
+    DWORD mode;
+
+    if (GetConsoleMode(handle, &mode))
+        SetConsoleMode(handle, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+#endif
+}
+
+// Write out everything, also at exit, so output isn't lost without logger close
+static void console_flush_all(void) {
+    p_mutex_lock(&console_lgg.lock);
+    console_flush(true);
+    console_report_dropped();
+    console_flush(true);
+    p_mutex_unlock(&console_lgg.lock);
+}
+
+int console_lgg_init(int flags) {
+    bool out_tty = p_isatty(p_fileno(stdout));
+    bool err_tty = p_isatty(p_fileno(stderr));
+
+    p_mutex_lock(&console_lgg.lock);
+    console_lgg.flags = flags;
+    console_lgg.buffered = !out_tty;
+    console_lgg.use_stdio = !out_tty && !(flags & CONSOLE_NONBLOCK);
+    if (!console_lgg.exit_flush)
+        console_lgg.exit_flush = atexit(console_flush_all) == 0;
+    console_lgg.out_tags = log_level_tags;
+    console_lgg.err_tags = log_level_tags;
+    if ((flags & CONSOLE_COLOR) && out_tty) {
+        console_enable_colors(p_fileno(stdout));
+        console_lgg.out_tags = console_color_tags;
+    }
+    if ((flags & CONSOLE_COLOR) && err_tty) {
+        console_enable_colors(p_fileno(stderr));
+        console_lgg.err_tags = console_color_tags;
+    }
+    p_mutex_unlock(&console_lgg.lock);
+
+    return 0;
+}
 
 void console_lgg_print(lgg_time *time, log_lvl level, uint16_t line, const char *file, const char *func, const char *fmt, va_list argptr) {
-    common_lgg_print(stdout, time, level, line, file, func, fmt, argptr);
+    char out[MAX_LOG_RECORD_LEN];
+    log_lvl tag = MIN(level, UNKNOWN_L);
+    const char *stack_text;
+    size_t stack_len;
+    int len;
+
+    if ((console_lgg.flags & CONSOLE_STDERR) && level <= ERROR_L) {
+        len = common_lgg_format(out, console_lgg.err_tags[tag], time, line, file, func, fmt, argptr);
+        // stderr is often the same terminal or file, so stdout line that's partly out is finished first.
+        // Line and its stack text go together
+        p_mutex_lock(&console_lgg.lock);
+        console_finish_line();
+        console_write_all(p_fileno(stderr), out, len);
+        if ((stack_text = log_stack_text(&console_lgg.stacks, &stack_len)) != NULL)
+            console_write_all(p_fileno(stderr), stack_text, stack_len);
+        p_mutex_unlock(&console_lgg.lock);
+        return;
+    }
+
+    len = common_lgg_format(out, console_lgg.out_tags[tag], time, line, file, func, fmt, argptr);
+    p_mutex_lock(&console_lgg.lock);
+    if (console_lgg.len == 0)
+        console_lgg.buffered_since = time->time;
+    console_report_dropped();
+    console_append(out, len);
+    if ((stack_text = log_stack_text(&console_lgg.stacks, &stack_len)) != NULL)
+        console_append(stack_text, stack_len);
+    if (!console_lgg.buffered || level <= ERROR_L || time->time - console_lgg.buffered_since >= CONSOLE_LGG_FLUSH_SECONDS)
+        console_flush(!(console_lgg.flags & CONSOLE_NONBLOCK));
+    p_mutex_unlock(&console_lgg.lock);
+}
+
+int console_lgg_close() {
+    console_flush_all();
+    // Next session prints stack text again, since its references shouldn't point to previous output
+    p_mutex_lock(&console_lgg.lock);
+    log_stack_set_clear(&console_lgg.stacks);
+    p_mutex_unlock(&console_lgg.lock);
+    return 0;
 }
 
-int file_lgg_init(const char *log_path, const char *log_name, int max_files) {
+// Remove log file together with its sidecar files
+static void remove_log_file(const char *log_file) {
+    char path[P_MAX_PATH];
+
+    remove(log_file);
+    lgg_index_path(path, log_file);
+    remove(path);
+    log_sidecar_path(path, log_file, TRACE_EXT);
+    remove(path);
+}
+
+int file_lgg_init(const char *log_path, const char *log_name, int max_files, int write_index, int per_thread) {
     uint64_t log_num;
     uint64_t count = 0;
     uint64_t n_fst = 0;
@@ -112,6 +492,13 @@ int file_lgg_init(const char *log_path, const char *log_name, int max_files) {
     }
 
 
+#endif
+
+#ifdef OS_WINDOWS
+#define NAMELIST_AT(i) (namelist[i].cFileName)
+#endif
+#ifdef OS_LINUX
+#define NAMELIST_AT(i) (namelist[i])
 #endif
 
     // Select from what name start look for free one
@@ -134,7 +521,7 @@ int file_lgg_init(const char *log_path, const char *log_name, int max_files) {
 #ifdef OS_LINUX
             strncat(buf, namelist[n_fst + count - 1], P_MAX_PATH);
 #endif
-            remove(buf);
+            remove_log_file(buf);
             --count;
             if (count == 0) {
                 // If there's no logfiles left stop deleting files
@@ -148,20 +535,31 @@ int file_lgg_init(const char *log_path, const char *log_name, int max_files) {
 #endif
         }
 
-        // Delete extra files
+        // Delete extra files. Per-thread files of one run share its number and count as one group
         if (max_files > 0) {
-            // We delete files until count = max_files-1, take into account that we have one more file to create
-            // and for that new state condition count <= max_files also must be true
-            while (count >= max_files) {
-                strncpy(buf, log_dir, P_MAX_PATH);
-#ifdef OS_WINDOWS
-                strncat(buf, namelist[n_fst++].cFileName, P_MAX_PATH);
-#endif
-#ifdef OS_LINUX
-                strncat(buf, namelist[n_fst++], P_MAX_PATH);
-#endif
+            uint64_t groups = 0;
+            uint64_t i;
+
+            for (i = n_fst; i < n_fst + count; i++) {
+                if (i == n_fst || extract_log_num(NAMELIST_AT(i)) != extract_log_num(NAMELIST_AT(i - 1)))
+                    groups++;
+            }
+
+            // We delete groups until groups = max_files-1, take into account that we have one more group to create
+            // and for that new state condition groups <= max_files also must be true
+            while (groups >= max_files) {
+                uint64_t group_num = extract_log_num(NAMELIST_AT(n_fst));
+
+                while (count > 0 && extract_log_num(NAMELIST_AT(n_fst)) == group_num) {
+                    strncpy(buf, log_dir, P_MAX_PATH);
+                    strncat(buf, NAMELIST_AT(n_fst++), P_MAX_PATH);
+                    remove_log_file(buf);
+                    --count;
+                }
+                // Trace of per-thread run is named after the group, not after any of its files
+                sprintf(buf, "%s%s.%lu" TRACE_EXT, log_dir, log_name, group_num);
                 remove(buf);
-                --count;
+                --groups;
             }
         }
 
@@ -175,19 +573,177 @@ int file_lgg_init(const char *log_path, const char *log_name, int max_files) {
     }
 
 
+#undef NAMELIST_AT
+
+    strcpy(file_lgg_path, buf);
+    file_lgg_per_thread = per_thread;
+    if (per_thread) {
+        // Threads open their files on the first message
+        file_lgg_write_index = write_index;
+        file_lgg_generation++;
+        return 0;
+    }
+
     file_lgg_output = fopen(buf, "w");
+    file_lgg_offset = 0;
     if (file_lgg_output == NULL) {
         return 1;
     }
-    else {
-        return 0;
+    if (write_index && lgg_index_open(&file_lgg_index, buf)) {
+        fclose(file_lgg_output);
+        file_lgg_output = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+// Advance file offset by line that was just written and add it to the index
+static void file_lgg_account(FILE *output, lgg_index *index, uint64_t *offset, lgg_time *time, log_lvl level, int written) {
+    if (written > 0) {
+#ifdef OS_WINDOWS
+        // Text mode stream translates newlines, so written length isn't a length in bytes
+        written = (int)(_ftelli64(output) - *offset);
+#endif
+        lgg_index_add(index, time->time, level, *offset, written);
+        *offset += written;
+    }
+}
+
+// File of calling thread, NULL if it has none or it was freed by close
+static lgg_thread_file *current_thread_file(void) {
+    return thread_file_generation == file_lgg_generation ? thread_file : NULL;
+}
+
+static int close_thread_file_output(lgg_thread_file *tf) {
+    int result = 0;
+
+    if (tf->output != NULL) {
+        result |= lgg_index_close(&tf->index);
+        result |= fclose(tf->output);
+    }
+    log_stack_set_clear(&tf->stacks);
+    return result;
+}
+
+// Runs in exiting thread. Key value may point to file that close already freed, so thread's own state is checked
+static void close_thread_file(void *arg) {
+    lgg_thread_file *tf;
+    int i;
+
+    p_mutex_lock(&thread_files_lock);
+    tf = current_thread_file();
+    if (tf != NULL) {
+        close_thread_file_output(tf);
+        for (i = 0; i < buf_len(thread_files); i++) {
+            if (thread_files[i] == tf) {
+                thread_files[i] = thread_files[--buf__hdr(thread_files)->len];
+                break;
+            }
+        }
+        free(tf);
+        thread_file = NULL;
+    }
+    p_mutex_unlock(&thread_files_lock);
+}
+
+// Open file of calling thread for current run, or return already opened one
+static lgg_thread_file *get_thread_file(void) {
+    lgg_thread_file *tf = current_thread_file();
+    char ext[32];
+    char path[P_MAX_PATH];
+    unsigned k;
+
+    if (tf != NULL)
+        return tf;
+
+    tf = (lgg_thread_file *)xmalloc(sizeof(lgg_thread_file));
+    tf->offset = 0;
+    tf->index.output = NULL;
+    tf->stacks = (log_stack_set) { NULL };
+
+    p_mutex_lock(&thread_files_lock);
+    // File of finished thread with the same tid is kept, lock makes sure nobody else takes the name
+    sprintf(ext, ".t%u.log", p_gettid());
+    log_sidecar_path(path, file_lgg_path, ext);
+    for (k = 1; file_exists(path); k++) {
+        sprintf(ext, ".t%u-%u.log", p_gettid(), k);
+        log_sidecar_path(path, file_lgg_path, ext);
     }
+    tf->output = fopen(path, "w");
+    // Without output file nothing is written, and there's no retry for every message
+    if (tf->output != NULL && file_lgg_write_index)
+        lgg_index_open(&tf->index, path);
+
+    if (!thread_file_key_created)
+        thread_file_key_created = p_thread_key_create(&thread_file_key, close_thread_file);
+    if (thread_file_key_created)
+        p_thread_key_set(thread_file_key, tf);
+    buf_push(thread_files, tf);
+    thread_file = tf;
+    thread_file_generation = file_lgg_generation;
+    p_mutex_unlock(&thread_files_lock);
+
+    return tf;
+}
+
+// Write text of captured stack after its line, if output doesn't have it yet. Call with stream locked
+static int file_lgg_write_stack(FILE *output, log_stack_set *seen) {
+    size_t len;
+    const char *text = log_stack_text(seen, &len);
+
+    return text != NULL ? (int)p_fwrite_unlocked(text, 1, len, output) : 0;
 }
 
 void file_lgg_print(lgg_time *time, log_lvl level, uint16_t line, const char *file, const char *func, const char *fmt, va_list argptr) {
-    common_lgg_print(file_lgg_output, time, level, line, file, func, fmt, argptr);
+    if (file_lgg_per_thread) {
+        lgg_thread_file *tf = get_thread_file();
+        char out[MAX_LOG_RECORD_LEN];
+        int len;
+
+        if (tf->output == NULL)
+            return;
+        // Nobody else writes to this file, so there's no need in stream lock
+        len = common_lgg_format(out, log_level_tags[MIN(level, UNKNOWN_L)], time, line, file, func, fmt, argptr);
+        len = (int)p_fwrite_unlocked(out, 1, len, tf->output);
+        len += file_lgg_write_stack(tf->output, &tf->stacks);
+        file_lgg_account(tf->output, &tf->index, &tf->offset, time, level, len);
+    } else {
+        char out[MAX_LOG_RECORD_LEN];
+        int len = common_lgg_format(out, log_level_tags[MIN(level, UNKNOWN_L)], time, line, file, func, fmt, argptr);
+
+        // Line is formatted outside of stream lock, but written under it together with offset and index
+        // bookkeeping, so offsets follow lines in file. Stack text goes with its line, and set of written
+        // stacks is shared by threads
+        p_flockfile(file_lgg_output);
+        len = (int)p_fwrite_unlocked(out, 1, len, file_lgg_output);
+        len += file_lgg_write_stack(file_lgg_output, &file_lgg_stacks);
+        file_lgg_account(file_lgg_output, &file_lgg_index, &file_lgg_offset, time, level, len);
+        p_funlockfile(file_lgg_output);
+    }
 }
 
+// All threads must stop logging before close
 int file_lgg_close() {
-    return fclose(file_lgg_output);
+    int result = 0;
+    int i;
+
+    if (file_lgg_output != NULL) {
+        result |= lgg_index_close(&file_lgg_index);
+        result |= fclose(file_lgg_output);
+        file_lgg_output = NULL;
+    }
+    log_stack_set_clear(&file_lgg_stacks);
+
+    p_mutex_lock(&thread_files_lock);
+    for (i = 0; i < buf_len(thread_files); i++) {
+        result |= close_thread_file_output(thread_files[i]);
+        free(thread_files[i]);
+    }
+    buf_free(thread_files);
+    // Pointers to freed files that threads still hold become stale
+    file_lgg_generation++;
+    file_lgg_per_thread = false;
+    p_mutex_unlock(&thread_files_lock);
+
+    return result;
 }
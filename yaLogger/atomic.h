@@ -4,8 +4,14 @@
 #include "common.h"
 #include "log_time.h"
 #include "log_levels.h"
+#include "log_index.h"
+#include "trace.h"
+#include "log_context.h"
+#include "log_stack.h"
 
 #define MAX_LOG_LINE_LEN 1024
+#define MAX_LOG_RECORD_LEN (4 * MAX_LOG_LINE_LEN) // User message plus time, level, file, line, func and context
+#define CONSOLE_LGG_BUF_SIZE (64 * 1024)
 
 typedef int(*log_init)();
 typedef int(*log_close)(void);
@@ -16,22 +22,40 @@ typedef enum {
     FILE_LGG
 } atom_lgg_type;
 
+// Console logger options (lgg_conf.console_flags)
+typedef enum {
+    CONSOLE_COLOR = 1 << 0,    // Colorize level tags with ANSI codes when writing to TTY
+    CONSOLE_STDERR = 1 << 1,   // Write ERROR and more severe levels to stderr, unbuffered
+    CONSOLE_NONBLOCK = 1 << 2  // Drop lines instead of blocking when stdout is backpressured
+} console_lgg_flags;
+
 typedef struct atomic_lgg {
     atom_lgg_type type;
     log_init init;
     log_print print;
     log_close close;
+    log_lvl verbosity; // Per-sink threshold, applied on top of the logger verbosity
 } atom_lgg;
 
+// Format of messages that are already formatted, with message length (int) and message as its arguments.
+// Sinks may format it as usual, bundled ones recognize it by address and copy all bytes of message as is
+extern const char lgg_msg_fmt[];
+
 //////////////////////////////////////////////////////////////////
 // Atomic loggers functions
 
-static inline void common_lgg_print(FILE *ostream, lgg_time *time, log_lvl level, uint16_t line, const char *file, const char *func, const char *fmt, va_list argptr);
+int common_lgg_format(char *out, const char *level_tag, lgg_time *time, uint16_t line, const char *file, const char *func, const char *fmt, va_list argptr);
+static inline int common_lgg_print(FILE *ostream, lgg_time *time, log_lvl level, uint16_t line, const char *file, const char *func, const char *fmt, va_list argptr);
 
+extern int console_lgg_init(int flags);
 extern void console_lgg_print(lgg_time *time, log_lvl level, uint16_t line, const char *file, const char *func, const char *fmt, va_list argptr);
 
+extern int console_lgg_close();
+
 extern FILE *file_lgg_output;
-extern int file_lgg_init(const char *log_path, const char *log_name, int max_files);
+extern char file_lgg_path[P_MAX_PATH];
+extern lgg_index file_lgg_index;
+extern int file_lgg_init(const char *log_path, const char *log_name, int max_files, int write_index, int per_thread);
 extern void file_lgg_print(lgg_time *time, log_lvl level, uint16_t line, const char *file, const char *func, const char *fmt, va_list argptr);
 extern int file_lgg_close();
 
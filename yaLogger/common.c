@@ -126,6 +126,13 @@ uint64_t extract_log_num(const char *filename) {
         ;
     start = ptr + 1;
 
+    // Per-thread log files have one more part: <name>.<n>.t<tid>.log or <name>.<n>.t<tid>-<k>.log
+    if (start[0] == 't' && isdigit((unsigned char)start[1]) && ptr > filename) {
+        while (*(--ptr) != '.' && ptr > filename)
+            ;
+        start = ptr + 1;
+    }
+
     if (start == end) {
         // Error: there's nothing between dots
         return -1;
@@ -140,6 +147,17 @@ uint64_t extract_log_num(const char *filename) {
     }
 }
 
+// Replace .log extension with ext, or append ext if there's no extension. dst can be the same buffer as log_file
+void log_sidecar_path(char *dst, const char *log_file, const char *ext) {
+    size_t len = strlen(log_file);
+
+    if (ends_with(log_file, ".log"))
+        len -= strlen(".log");
+    len = MIN(len, P_MAX_PATH - strlen(ext) - 1);
+    memmove(dst, log_file, len);
+    strcpy(dst + len, ext);
+}
+
 void *buf__grow(const void *buf, size_t new_len, size_t elem_size) {
     assert(buf_cap(buf) <= (SIZE_MAX - 1) / 2);
     size_t new_cap = CLAMP_MIN(2 * buf_cap(buf), MAX(new_len, 16));
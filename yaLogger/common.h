@@ -47,6 +47,7 @@ bool starts_with(const char *pre, const char *str);
 bool ends_with(const char *str, const char *ext);
 
 uint64_t extract_log_num(const char *filename);
+void log_sidecar_path(char *dst, const char *log_file, const char *ext);
 
 // Stretchy buffer
 
@@ -0,0 +1,86 @@
+#include "log_context.h"
+
+typedef struct {
+    char key[LOG_CONTEXT_MAX_KEY_LEN];
+    char value[LOG_CONTEXT_MAX_VALUE_LEN];
+} context_entry;
+
+typedef struct {
+    int count;
+    context_entry entries[LOG_CONTEXT_MAX_KEYS];
+    size_t len;
+    char fragment[LOG_CONTEXT_MAX_LEN];
+} log_context;
+
+static p_thread_local log_context context;
+
+static void render_context(void) {
+    char *ptr = context.fragment;
+    int i;
+
+    context.len = 0;
+    if (context.count == 0)
+        return;
+
+    *ptr++ = '[';
+    for (i = 0; i < context.count; i++) {
+        size_t key_len = strlen(context.entries[i].key);
+        size_t value_len = strlen(context.entries[i].value);
+
+        if (i > 0)
+            *ptr++ = ' ';
+        memcpy(ptr, context.entries[i].key, key_len);
+        ptr += key_len;
+        *ptr++ = '=';
+        memcpy(ptr, context.entries[i].value, value_len);
+        ptr += value_len;
+    }
+    *ptr++ = ']';
+    *ptr++ = ' ';
+    context.len = ptr - context.fragment;
+}
+
+static int find_key(const char *key) {
+    int i;
+
+    for (i = 0; i < context.count; i++) {
+        if (strncmp(context.entries[i].key, key, LOG_CONTEXT_MAX_KEY_LEN - 1) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// Keys and values longer than limits are truncated. New key over LOG_CONTEXT_MAX_KEYS is ignored
+void log_context_set(const char *key, const char *value) {
+    int i = find_key(key);
+
+    if (i < 0) {
+        if (context.count == LOG_CONTEXT_MAX_KEYS)
+            return;
+        i = context.count++;
+        snprintf(context.entries[i].key, LOG_CONTEXT_MAX_KEY_LEN, "%s", key);
+    }
+    snprintf(context.entries[i].value, LOG_CONTEXT_MAX_VALUE_LEN, "%s", value);
+    render_context();
+}
+
+void log_context_remove(const char *key) {
+    int i = find_key(key);
+
+    if (i < 0)
+        return;
+    // Keep order in which keys were added
+    memmove(&context.entries[i], &context.entries[i + 1], (context.count - i - 1) * sizeof(context_entry));
+    context.count--;
+    render_context();
+}
+
+void log_context_clear(void) {
+    context.count = 0;
+    render_context();
+}
+
+const char *log_context_fragment(size_t *len) {
+    *len = context.len;
+    return context.fragment;
+}
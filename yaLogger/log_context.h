@@ -0,0 +1,22 @@
+#ifndef LOG_CONTEXT_H
+#define LOG_CONTEXT_H
+
+#include "common.h"
+
+//////////////////////////////////////////////////////////////////
+// Per-thread diagnostic context: key=value pairs added to every line logged by the thread.
+// Context is rendered into "[key=value key=value] " fragment when it changes, so log line
+// only copies the fragment
+
+#define LOG_CONTEXT_MAX_KEYS 8
+#define LOG_CONTEXT_MAX_KEY_LEN 32
+#define LOG_CONTEXT_MAX_VALUE_LEN 64
+#define LOG_CONTEXT_MAX_LEN (LOG_CONTEXT_MAX_KEYS * (LOG_CONTEXT_MAX_KEY_LEN + LOG_CONTEXT_MAX_VALUE_LEN) + 4)
+
+void log_context_set(const char *key, const char *value);
+void log_context_remove(const char *key);
+void log_context_clear(void);
+
+const char *log_context_fragment(size_t *len);
+
+#endif // LOG_CONTEXT_H
@@ -0,0 +1,82 @@
+#include "log_index.h"
+
+void lgg_index_path(char *idx_path, const char *log_file) {
+    log_sidecar_path(idx_path, log_file, LGG_IDX_EXT);
+}
+
+int lgg_index_open(lgg_index *idx, const char *log_file) {
+    char path[P_MAX_PATH];
+
+    lgg_index_path(path, log_file);
+    idx->has_bucket = false;
+    idx->output = fopen(path, "wb");
+    if (idx->output == NULL) {
+        return 1;
+    }
+    if (fwrite(LGG_IDX_MAGIC, sizeof(LGG_IDX_MAGIC), 1, idx->output) != 1) {
+        fclose(idx->output);
+        idx->output = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+static void lgg_index_flush(lgg_index *idx) {
+    if (idx->has_bucket) {
+        fwrite(&idx->bucket, sizeof(lgg_idx_entry), 1, idx->output);
+        idx->has_bucket = false;
+    }
+}
+
+void lgg_index_add(lgg_index *idx, int64_t time, log_lvl level, uint64_t offset, uint64_t len) {
+    if (idx->output == NULL)
+        return;
+
+    // Bucket can be written only after it's closed, because until then its length and levels aren't known
+    if (idx->has_bucket && (idx->bucket.time != time || idx->bucket.len >= LGG_IDX_BUCKET_BYTES))
+        lgg_index_flush(idx);
+
+    if (!idx->has_bucket) {
+        idx->bucket = (lgg_idx_entry) { time, offset, 0, 0, 0 };
+        idx->has_bucket = true;
+    }
+    idx->bucket.len += len;
+    if (level <= UNKNOWN_L)
+        idx->bucket.level_mask |= 1u << level;
+}
+
+int lgg_index_close(lgg_index *idx) {
+    int result;
+
+    if (idx->output == NULL)
+        return 0;
+
+    lgg_index_flush(idx);
+    result = fclose(idx->output);
+    idx->output = NULL;
+    return result;
+}
+
+// Read all entries of the index for log_file. Returns NULL if there's no index or it's damaged
+lgg_idx_entry *lgg_index_load(const char *log_file) {
+    char path[P_MAX_PATH];
+    char magic[sizeof(LGG_IDX_MAGIC)];
+    lgg_idx_entry entry;
+    lgg_idx_entry *entries = NULL;
+    FILE *input;
+
+    lgg_index_path(path, log_file);
+    input = fopen(path, "rb");
+    if (input == NULL) {
+        return NULL;
+    }
+
+    if (fread(magic, sizeof(magic), 1, input) == 1 && memcmp(magic, LGG_IDX_MAGIC, sizeof(magic)) == 0) {
+        // Partially written last entry (e.g. after crash) is just ignored
+        while (fread(&entry, sizeof(lgg_idx_entry), 1, input) == 1)
+            buf_push(entries, entry);
+    }
+
+    fclose(input);
+    return entries;
+}
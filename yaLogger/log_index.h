@@ -0,0 +1,40 @@
+#ifndef LOG_INDEX_H
+#define LOG_INDEX_H
+
+#include "common.h"
+#include "log_levels.h"
+
+//////////////////////////////////////////////////////////////////
+// Sparse sidecar index for log files
+//
+// <name>.<n>.log gets <name>.<n>.idx next to it. Index file is a magic
+// header followed by one entry per bucket. Bucket is a run of lines
+// logged within the same second, split when it grows over LGG_IDX_BUCKET_BYTES.
+
+#define LGG_IDX_MAGIC "YALIDX1"
+#define LGG_IDX_EXT ".idx"
+#define LGG_IDX_BUCKET_BYTES (64 * 1024)
+
+typedef struct {
+    int64_t time;        // Seconds since epoch, same for every line in bucket
+    uint64_t offset;     // Byte position of the first line in bucket
+    uint64_t len;        // Bucket length in bytes
+    uint32_t level_mask; // Bit (1 << level) set for each level present in bucket
+    uint32_t reserved;
+} lgg_idx_entry;
+
+typedef struct {
+    FILE *output;
+    lgg_idx_entry bucket;
+    bool has_bucket;
+} lgg_index;
+
+void lgg_index_path(char *idx_path, const char *log_file);
+
+int lgg_index_open(lgg_index *idx, const char *log_file);
+void lgg_index_add(lgg_index *idx, int64_t time, log_lvl level, uint64_t offset, uint64_t len);
+int lgg_index_close(lgg_index *idx);
+
+lgg_idx_entry *lgg_index_load(const char *log_file);
+
+#endif // LOG_INDEX_H
@@ -24,4 +24,17 @@ char *log_level_to_str(log_lvl level) {
     case UNKNOWN_L:
         return "UNK";
     }
-}
\ No newline at end of file
+}
+
+const char *log_level_tags[UNKNOWN_L + 1] = {
+    "[FATAL]",
+    "[ALERT]",
+    "[CRIT ]",
+    "[ERROR]",
+    "[WARN ]",
+    "[NOTE ]",
+    "[INFO ]",
+    "[DEBUG]",
+    "[N/S  ]",
+    "[UNK  ]"
+};
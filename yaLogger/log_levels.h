@@ -16,4 +16,7 @@ typedef enum {
 
 char *log_level_to_str(log_lvl level);
 
+// Level names padded and bracketed as they appear in log lines, e.g. "[WARN ]"
+extern const char *log_level_tags[UNKNOWN_L + 1];
+
 #endif // LOG_LEVELS_H
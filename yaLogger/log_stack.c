@@ -0,0 +1,200 @@
+#include "log_stack.h"
+
+#define STACK_CACHE_INIT_CAP 64
+
+typedef struct {
+    uint64_t hash;
+    int depth;
+    void *frames[LOG_STACK_MAX_FRAMES];
+} raw_stack;
+
+typedef struct {
+    raw_stack stack;
+    size_t text_len;
+    char *text;
+} stack_entry;
+
+// Stack of the line that calling thread is logging now, depth is 0 if there's none
+static p_thread_local raw_stack current;
+
+// Symbolized stacks, open addressing by hash. Entries aren't modified after insertion
+static stack_entry **stack_cache = NULL;
+static size_t stack_cache_cap = 0;
+static size_t stack_cache_count = 0;
+static p_mutex stack_cache_lock = P_MUTEX_INITIALIZER;
+
+static uint64_t hash_frames(void **frames, int depth) {
+    uint64_t hash = 14695981039346656037ull;
+    int i;
+
+    for (i = 0; i < depth; i++) {
+        hash ^= (uint64_t)(uintptr_t)frames[i];
+        hash *= 1099511628211ull;
+        hash ^= hash >> 29;
+    }
+    // 0 marks empty slot in sets
+    return hash != 0 ? hash : 1;
+}
+
+void log_stack_capture(int skip) {
+    void *frames[LOG_STACK_MAX_FRAMES + 8];
+    int depth;
+
+    assert(skip >= 0 && skip < 8);
+    // One more frame for this function
+    skip++;
+    depth = p_backtrace(frames, LOG_STACK_MAX_FRAMES + skip);
+    current.depth = MAX(depth - skip, 0);
+    memcpy(current.frames, frames + skip, current.depth * sizeof(void *));
+    current.hash = hash_frames(current.frames, current.depth);
+}
+
+void log_stack_release(void) {
+    current.depth = 0;
+}
+
+bool log_stack_captured(void) {
+    return current.depth > 0;
+}
+
+size_t log_stack_ref(char *dst) {
+    if (current.depth == 0) {
+        dst[0] = '\0';
+        return 0;
+    }
+    return sprintf(dst, " [stack=%016llx]", (unsigned long long)current.hash);
+}
+
+// Render frames as "    #<n> <symbol>\n" lines
+static char *symbolize(raw_stack *stack, size_t *len) {
+    char **symbols = NULL;
+    char *text, *ptr;
+    size_t size = 0;
+    int i;
+
+#ifdef OS_LINUX
+    symbols = backtrace_symbols(stack->frames, stack->depth);
+#endif
+    for (i = 0; i < stack->depth; i++)
+        size += 32 + (symbols != NULL ? strlen(symbols[i]) : 0);
+
+    text = ptr = (char *)xmalloc(size + 1);
+    for (i = 0; i < stack->depth; i++) {
+        if (symbols != NULL)
+            ptr += sprintf(ptr, "    #%d %s\n", i, symbols[i]);
+        else
+            ptr += sprintf(ptr, "    #%d %p\n", i, stack->frames[i]);
+    }
+    free(symbols);
+
+    *len = ptr - text;
+    return text;
+}
+
+static stack_entry **cache_slot(stack_entry **cache, size_t cap, raw_stack *stack) {
+    size_t i = stack->hash & (cap - 1);
+
+    while (cache[i] != NULL && (cache[i]->stack.hash != stack->hash || cache[i]->stack.depth != stack->depth ||
+           memcmp(cache[i]->stack.frames, stack->frames, stack->depth * sizeof(void *)) != 0))
+    {
+        i = (i + 1) & (cap - 1);
+    }
+    return &cache[i];
+}
+
+static void cache_grow(void) {
+    size_t cap = stack_cache_cap > 0 ? 2 * stack_cache_cap : STACK_CACHE_INIT_CAP;
+    stack_entry **cache = (stack_entry **)xmalloc(cap * sizeof(stack_entry *));
+    size_t i;
+
+    memset(cache, 0, cap * sizeof(stack_entry *));
+    for (i = 0; i < stack_cache_cap; i++) {
+        if (stack_cache[i] != NULL)
+            *cache_slot(cache, cap, &stack_cache[i]->stack) = stack_cache[i];
+    }
+    free(stack_cache);
+    stack_cache = cache;
+    stack_cache_cap = cap;
+}
+
+// Find symbolized stack or symbolize it once
+static stack_entry *cache_get(raw_stack *stack) {
+    stack_entry **slot;
+    stack_entry *entry;
+
+    p_mutex_lock(&stack_cache_lock);
+    if (2 * (stack_cache_count + 1) > stack_cache_cap)
+        cache_grow();
+    slot = cache_slot(stack_cache, stack_cache_cap, stack);
+    if (*slot == NULL) {
+        entry = (stack_entry *)xmalloc(sizeof(stack_entry));
+        entry->stack = *stack;
+        entry->text = symbolize(stack, &entry->text_len);
+        *slot = entry;
+        stack_cache_count++;
+    }
+    entry = *slot;
+    p_mutex_unlock(&stack_cache_lock);
+
+    return entry;
+}
+
+// Returns true if hash wasn't in set
+static bool stack_set_add(log_stack_set *set, uint64_t hash) {
+    size_t i;
+
+    if (2 * (set->count + 1) > set->cap) {
+        log_stack_set grown = { NULL, set->cap > 0 ? 2 * set->cap : STACK_CACHE_INIT_CAP, 0 };
+
+        grown.slots = (uint64_t *)xmalloc(grown.cap * sizeof(uint64_t));
+        memset(grown.slots, 0, grown.cap * sizeof(uint64_t));
+        for (i = 0; i < set->cap; i++) {
+            if (set->slots[i] != 0)
+                stack_set_add(&grown, set->slots[i]);
+        }
+        free(set->slots);
+        *set = grown;
+    }
+
+    for (i = hash & (set->cap - 1); set->slots[i] != 0; i = (i + 1) & (set->cap - 1)) {
+        if (set->slots[i] == hash)
+            return false;
+    }
+    set->slots[i] = hash;
+    set->count++;
+    return true;
+}
+
+const char *log_stack_text(log_stack_set *seen, size_t *len) {
+    stack_entry *entry;
+
+    if (current.depth == 0 || !stack_set_add(seen, current.hash))
+        return NULL;
+    entry = cache_get(&current);
+    *len = entry->text_len;
+    return entry->text;
+}
+
+void log_stack_set_clear(log_stack_set *set) {
+    free(set->slots);
+    set->slots = NULL;
+    set->cap = 0;
+    set->count = 0;
+}
+
+void log_stack_close(void) {
+    size_t i;
+
+    p_mutex_lock(&stack_cache_lock);
+    for (i = 0; i < stack_cache_cap; i++) {
+        if (stack_cache[i] != NULL) {
+            free(stack_cache[i]->text);
+            free(stack_cache[i]);
+        }
+    }
+    free(stack_cache);
+    stack_cache = NULL;
+    stack_cache_cap = 0;
+    stack_cache_count = 0;
+    p_mutex_unlock(&stack_cache_lock);
+}
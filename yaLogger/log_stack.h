@@ -0,0 +1,37 @@
+#ifndef LOG_STACK_H
+#define LOG_STACK_H
+
+#include "common.h"
+
+//////////////////////////////////////////////////////////////////
+// Stack traces of ERROR and more severe lines (lgg_conf.stack_traces).
+// Calling thread only captures raw frame addresses. Sinks symbolize them when line is written,
+// through process-wide cache keyed by stack hash, so known stack costs one lookup.
+// Line gets " [stack=<id>]" reference, and each output gets symbol text after the line
+// only the first time it sees the stack
+
+#define LOG_STACK_MAX_FRAMES 32
+#define LOG_STACK_REF_LEN 27 // " [stack=" + 16 hex digits + "]" + '\0'
+
+// Hashes of stacks whose text was written to one output
+typedef struct {
+    uint64_t *slots; // Open addressing, 0 is empty slot
+    size_t cap;
+    size_t count;
+} log_stack_set;
+
+// Capture stack of calling thread for the line being logged. skip is number of logger frames above caller
+void log_stack_capture(int skip);
+void log_stack_release(void);
+bool log_stack_captured(void);
+
+// Reference to captured stack, empty string if there's none. Returns its length
+size_t log_stack_ref(char *dst);
+// Symbol text of captured stack, if seen doesn't have it yet (and then it's added to seen). NULL otherwise
+const char *log_stack_text(log_stack_set *seen, size_t *len);
+
+void log_stack_set_clear(log_stack_set *set);
+// Free symbol cache. All threads must stop logging before
+void log_stack_close(void);
+
+#endif // LOG_STACK_H
@@ -3,23 +3,90 @@
 //////////////////////////////////////////////////////////////////
 // Message preprocessing
 
+static const char *months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
 // Date and time functions
 char *get_datetime_str(lgg_time *time) {
-    char *timeline, year[5], *tmp;
+    char *timeline = (char *)xmalloc(DATETIME_STR_LEN + 1);
+
+    format_datetime(timeline, time);
+    return timeline;
+}
 
-    if (time == NULL)
-        return "0";
+// Write timestamp to out, which must hold DATETIME_STR_LEN + 1 bytes. Returns its length
+int format_datetime(char *out, lgg_time *time) {
+    // Everything but milliseconds changes once per second, so it's formatted once and then copied
+    static p_thread_local time_t cached_time = -1;
+    static p_thread_local char cached_str[DATETIME_STR_LEN - 4 + 1];
+    unsigned ms;
 
-    // Format time
-    tmp = ctime(time);
-    strncpy(year, tmp + 20, 4);
-    year[4] = '\0';
+    if (time == NULL) {
+        strcpy(out, "0");
+        return 1;
+    }
 
-    timeline = (char *)xmalloc(strlen(tmp) * sizeof(char));
+    if (time->time != cached_time) {
+        struct tm tm;
+        char tmp[64];
 
-    // Assemble final string and cut off unused parts
-    // TODO: Make time format more compact and numeric
-    sprintf(timeline, "%s %.*s.%03d", year, 18 - 3, tmp + 4, time->millitm);
+        // Same fields as ctime gives, but it's reentrant, since threads format lines concurrently.
+        // Month names are spelled out to not depend on locale
+        // TODO: Make time format more compact and numeric
+        p_localtime(&time->time, &tm);
+        snprintf(tmp, sizeof(tmp), "%d %.3s %2d %02d:%02d:%02d",
+                 tm.tm_year + 1900, months + tm.tm_mon * 3, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+        memcpy(cached_str, tmp, DATETIME_STR_LEN - 4);
+        cached_time = time->time;
+    }
 
-    return timeline;
+    memcpy(out, cached_str, DATETIME_STR_LEN - 4);
+    ms = time->millitm % 1000;
+    out[DATETIME_STR_LEN - 4] = '.';
+    out[DATETIME_STR_LEN - 3] = '0' + ms / 100;
+    out[DATETIME_STR_LEN - 2] = '0' + ms / 10 % 10;
+    out[DATETIME_STR_LEN - 1] = '0' + ms % 10;
+    out[DATETIME_STR_LEN] = '\0';
+    return DATETIME_STR_LEN;
+}
+
+// Parse timestamp written by format_datetime. str doesn't have to be null-terminated
+bool parse_datetime(const char *str, size_t len, time_t *time, unsigned *ms) {
+    char head[DATETIME_STR_LEN + 1];
+    char mon[4];
+    const char *found;
+    struct tm tm = { 0 };
+
+    if (len < DATETIME_STR_LEN)
+        return false;
+    memcpy(head, str, DATETIME_STR_LEN);
+    head[DATETIME_STR_LEN] = '\0';
+    if (sscanf(head, "%d %3s %d %d:%d:%d.%u", &tm.tm_year, mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec, ms) != 7)
+        return false;
+    if ((found = strstr(months, mon)) == NULL || (found - months) % 3 != 0)
+        return false;
+    tm.tm_year -= 1900;
+    tm.tm_mon = (int)(found - months) / 3;
+    tm.tm_isdst = -1;
+    *time = mktime(&tm);
+    return true;
+}
+
+// Nanoseconds from unspecified starting point, never goes back
+uint64_t monotonic_ns(void) {
+#ifdef OS_WINDOWS
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000000 +
+           (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
+#endif
+#ifdef OS_LINUX
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
 }
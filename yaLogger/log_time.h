@@ -7,6 +7,11 @@ typedef struct timeb lgg_time;
 
 #define CAPTURE_TIME(lgg) (p_ftime(&((lgg)->timestamp)))
 
+#define DATETIME_STR_LEN 24 // "2019 Apr 29 20:01:18.615"
+
 char *get_datetime_str(lgg_time *);
+int format_datetime(char *out, lgg_time *time);
+bool parse_datetime(const char *str, size_t len, time_t *time, unsigned *ms);
+uint64_t monotonic_ns(void);
 
 #endif // LOG_TIME_H
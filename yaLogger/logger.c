@@ -2,9 +2,84 @@
 #include "log_time.h"
 #include "atomic.h"
 
+static bool sink_enabled(logger *lgg, atom_lgg *sink, log_lvl level) {
+    return sink->print != NULL && level <= lgg->conf->verbosity && level <= sink->verbosity;
+}
+
+// Writers of sinks and levels (add__atomic__lgg, set__log__lvl, set__atomic__lgg__lvl) are serialized
+static p_mutex dispatch_lock = P_MUTEX_INITIALIZER;
+
+static size_t dispatch__size(lgg_dispatch *table) {
+    return offsetof(lgg_dispatch, sinks) + table->start[UNKNOWN_L + 1] * sizeof(log_print);
+}
+
+static bool dispatch__equal(lgg_dispatch *a, lgg_dispatch *b) {
+    return dispatch__size(a) == dispatch__size(b) && memcmp(a, b, dispatch__size(a)) == 0;
+}
+
+// Build new dispatch table from current sinks and levels, then publish it with single pointer swap.
+// Readers may still use replaced table, so tables aren't freed before close. Instead table that
+// was built before for the same levels is published again, so toggling levels doesn't allocate.
+// Call under dispatch_lock
+static void rebuild__dispatch(logger *lgg) {
+    lgg_dispatch *table, *old;
+    size_t n = 0;
+    int lvl, i;
+
+    for (lvl = FATAL_L; lvl <= UNKNOWN_L; lvl++) {
+        for (i = 0; i < buf_len(lgg->atom_buf); i++) {
+            if (sink_enabled(lgg, &lgg->atom_buf[i], lvl))
+                n++;
+        }
+    }
+
+    table = (lgg_dispatch *)xmalloc(offsetof(lgg_dispatch, sinks) + n * sizeof(log_print));
+    n = 0;
+    for (lvl = FATAL_L; lvl <= UNKNOWN_L; lvl++) {
+        table->start[lvl] = n;
+        for (i = 0; i < buf_len(lgg->atom_buf); i++) {
+            if (sink_enabled(lgg, &lgg->atom_buf[i], lvl))
+                table->sinks[n++] = lgg->atom_buf[i].print;
+        }
+    }
+    table->start[UNKNOWN_L + 1] = n;
+
+    old = lgg->dispatch;
+    if (old != NULL && dispatch__equal(old, table)) {
+        free(table);
+        return;
+    }
+    for (i = 0; i < buf_len(lgg->retired_buf); i++) {
+        if (dispatch__equal(lgg->retired_buf[i], table)) {
+            free(table);
+            table = lgg->retired_buf[i];
+            // Only tables that aren't published stay in retired_buf
+            lgg->retired_buf[i] = lgg->retired_buf[--buf__hdr(lgg->retired_buf)->len];
+            break;
+        }
+    }
+
+    p_atomic_store_ptr(&lgg->dispatch, table);
+    if (old != NULL)
+        buf_push(lgg->retired_buf, old);
+}
+
+static void free__dispatch(logger *lgg) {
+    int i;
+
+    for (i = 0; i < buf_len(lgg->retired_buf); i++)
+        free(lgg->retired_buf[i]);
+    buf_free(lgg->retired_buf);
+    free(lgg->dispatch);
+    lgg->dispatch = NULL;
+}
+
 void add__atomic__lgg(logger *lgg, atom_lgg_type type, log_init init_func, log_print print_func, log_close close_func) {
     assert(print_func != NULL);
-    buf_push(lgg->atom_buf, (atom_lgg) { type, init_func, print_func, close_func });
+    p_mutex_lock(&dispatch_lock);
+    buf_push(lgg->atom_buf, (atom_lgg) { type, init_func, print_func, close_func, UNKNOWN_L });
+    rebuild__dispatch(lgg);
+    p_mutex_unlock(&dispatch_lock);
 }
 
 logger *logger__init(lgg_conf *params) {
@@ -28,22 +103,35 @@ logger *logger__init(lgg_conf *params) {
         lgg->conf->log_path = p_getcwd(NULL, 0);
         lgg->conf->verbosity = DEBUG_L;
         lgg->conf->max_files = 0;
+        lgg->conf->write_index = false;
+        lgg->conf->console_flags = 0;
+        lgg->conf->trace_sampling = 0;
+        lgg->conf->per_thread_files = false;
+        lgg->conf->stack_traces = false;
     }
     lgg->atom_buf = NULL;
     lgg->module_buf = NULL;
+    lgg->dispatch = NULL;
+    lgg->retired_buf = NULL;
     CAPTURE_TIME(lgg); // Initialize llg->timestamp
 
     // Add atomic loggers
-    add__atomic__lgg(lgg, CONSOLE_LGG, NULL, console_lgg_print, NULL);
+    add__atomic__lgg(lgg, CONSOLE_LGG, console_lgg_init, console_lgg_print, console_lgg_close);
     add__atomic__lgg(lgg, FILE_LGG, file_lgg_init, file_lgg_print, file_lgg_close);
 
-    // Init all added atomic loggers (currently only file logger)
+    // Init all added atomic loggers
     assert(lgg->atom_buf != NULL);
     for (i = 0; i < buf_len(lgg->atom_buf); i++) {
+        if (lgg->atom_buf[i].init != NULL &&
+            lgg->atom_buf[i].type == CONSOLE_LGG)
+        {
+            lgg->atom_buf[i].init(lgg->conf->console_flags);
+        }
         if (lgg->atom_buf[i].init != NULL &&
             lgg->atom_buf[i].type == FILE_LGG)
         {
-            if (lgg->atom_buf[i].init(lgg->conf->log_path, lgg->conf->log_name, lgg->conf->max_files)) {
+            if (lgg->atom_buf[i].init(lgg->conf->log_path, lgg->conf->log_name, lgg->conf->max_files, lgg->conf->write_index, lgg->conf->per_thread_files)) {
+                free__dispatch(lgg);
                 buf_free(lgg->atom_buf);
                 buf_free(lgg->module_buf);
                 free(lgg);
@@ -52,27 +140,93 @@ logger *logger__init(lgg_conf *params) {
         }
     }
 
+    // Trace file is named after log file, so it's opened after file logger.
+    // Tracing is optional, if it can't be started logger works without it
+    if (lgg->conf->trace_sampling > 0)
+        trace_lgg_init(file_lgg_path, lgg->conf->trace_sampling);
+
     return lgg;
 }
 
+// Stack of the caller is captured if it's enabled and some sink takes the line
+static bool stack__wanted(logger *lgg, lgg_dispatch *table, log_lvl level) {
+    return lgg->conf->stack_traces && level <= ERROR_L && table->start[level] != table->start[level + 1];
+}
+
 void print__log(logger *lgg, log_lvl level, uint16_t line, const char *file, const char *func, const char *fmt, ...) {
     va_list args;
-    int i;
+    lgg_time now;
+    lgg_dispatch *table;
+    bool stack;
+    size_t i;
 
-    if (lgg == NULL && (lgg = logger__init(NULL)) == NULL) {
+    if (lgg == NULL && (lgg = logger__init(NULL)) == NULL)
         fatal("Logger initialization failed");
-    } else {
-        // If logger initialized - capture time, if not - time will be captured during init
-        CAPTURE_TIME(lgg);
-    }
+    // Time of the call goes to sinks from caller's stack, so threads never see each other's time
+    p_ftime(&now);
 
-    assert(lgg->atom_buf != NULL);
+    // Levels out of range are never enabled
+    if ((unsigned)level > UNKNOWN_L)
+        return;
+
+    table = p_atomic_load_ptr(&lgg->dispatch);
+    assert(table != NULL);
+    stack = stack__wanted(lgg, table, level);
+    if (stack)
+        log_stack_capture(1); // Skip print function itself
     va_start(args, fmt);
-    for (i = 0; i < buf_len(lgg->atom_buf); i++) {
-        if (lgg->atom_buf[i].print != NULL && level <= lgg->conf->verbosity)
-            lgg->atom_buf[i].print(&(lgg->timestamp), level, line, file, func, fmt, args);
-    }
+    for (i = table->start[level]; i < table->start[level + 1]; i++)
+        table->sinks[i](&now, level, line, file, func, fmt, args);
     va_end(args);
+    if (stack)
+        log_stack_release();
+}
+
+// Sinks get preformatted message as usual arguments, lgg_msg_fmt, its length and msg
+static void print__sink__msg(log_print print, lgg_time *time, log_lvl level, uint16_t line, const char *file, const char *func, const char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    print(time, level, line, file, func, fmt, args);
+    va_end(args);
+}
+
+// Same as print__log, but msg is already formatted and its len bytes are printed as is
+void print__log__str(logger *lgg, log_lvl level, uint16_t line, const char *file, const char *func, const char *msg, size_t len) {
+    lgg_time now;
+    lgg_dispatch *table;
+    bool stack;
+    size_t i;
+
+    if (lgg == NULL && (lgg = logger__init(NULL)) == NULL)
+        fatal("Logger initialization failed");
+    p_ftime(&now);
+
+    if ((unsigned)level > UNKNOWN_L)
+        return;
+
+    table = p_atomic_load_ptr(&lgg->dispatch);
+    assert(table != NULL);
+    stack = stack__wanted(lgg, table, level);
+    if (stack)
+        log_stack_capture(1); // Skip print function itself
+    for (i = table->start[level]; i < table->start[level + 1]; i++)
+        print__sink__msg(table->sinks[i], &now, level, line, file, func, lgg_msg_fmt, (int)len, msg);
+    if (stack)
+        log_stack_release();
+}
+
+// Check if any sink takes messages of this level, so message formatting can be skipped.
+// Not initialized logger will be initialized with default settings that enable all levels
+bool log__lvl__enabled(logger *lgg, log_lvl level) {
+    lgg_dispatch *table;
+
+    if (lgg == NULL)
+        return true;
+    if ((unsigned)level > UNKNOWN_L)
+        return false;
+    table = p_atomic_load_ptr(&lgg->dispatch);
+    return table->start[level] != table->start[level + 1];
 }
 
 int logger__close(logger *lgg) {
@@ -87,7 +241,10 @@ int logger__close(logger *lgg) {
                     lgg->atom_buf[i].close();
             }
         }
+        trace_lgg_close();
+        log_stack_close();
 
+        free__dispatch(lgg);
         buf_free(lgg->atom_buf);
         buf_free(lgg->module_buf);
         free(lgg);
@@ -99,9 +256,34 @@ int logger__close(logger *lgg) {
 }
 
 void set__log__lvl(logger *lgg, log_lvl level) {
+    p_mutex_lock(&dispatch_lock);
     // Not allow user set UNKNOWN log level directly
     if (level >= FATAL_L && level <= NOTSET_L)
         lgg->conf->verbosity = level;
     else
         lgg->conf->verbosity = UNKNOWN_L;
+    rebuild__dispatch(lgg);
+    p_mutex_unlock(&dispatch_lock);
+}
+
+void trace__begin(logger *lgg, const char *name, uint16_t line, const char *file, const char *func) {
+    if (lgg != NULL && lgg->conf->trace_sampling > 0)
+        trace_lgg_begin(name, line, file, func);
+}
+
+void trace__end(logger *lgg) {
+    if (lgg != NULL && lgg->conf->trace_sampling > 0)
+        trace_lgg_end();
+}
+
+void set__atomic__lgg__lvl(logger *lgg, atom_lgg_type type, log_lvl level) {
+    int i;
+
+    p_mutex_lock(&dispatch_lock);
+    for (i = 0; i < buf_len(lgg->atom_buf); i++) {
+        if (lgg->atom_buf[i].type == type)
+            lgg->atom_buf[i].verbosity = level;
+    }
+    rebuild__dispatch(lgg);
+    p_mutex_unlock(&dispatch_lock);
 }
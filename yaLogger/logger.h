@@ -11,6 +11,11 @@ typedef struct {
     char *log_name;
     log_lvl verbosity;
     int max_files;
+    bool write_index; // Write sparse .idx file next to each log file, used by yal-query
+    int console_flags; // console_lgg_flags
+    int trace_sampling; // Record spans of one in this many top-level LOG_SPANs, 0 disables tracing
+    bool per_thread_files; // Each thread writes its own <name>.<n>.t<tid>.log, merged with yal-merge
+    bool stack_traces; // Attach stack trace to ERROR and more severe lines, symbol text is written once per unique stack
 } lgg_conf;
 
 typedef struct {
@@ -18,11 +23,20 @@ typedef struct {
     log_lvl verbosity;
 } lgg_module;
 
+// Sinks enabled for each level, flattened: sinks for level L are
+// sinks[start[L]] .. sinks[start[L + 1] - 1]. Never modified after publishing.
+typedef struct {
+    size_t start[UNKNOWN_L + 2];
+    log_print sinks[];
+} lgg_dispatch;
+
 typedef struct {
     lgg_conf *conf;
     atom_lgg *atom_buf;
     lgg_module *module_buf;
-    struct timeb timestamp;
+    lgg_dispatch *dispatch;
+    lgg_dispatch **retired_buf; // Replaced tables, reused for the same levels and freed on close since readers may still use them
+    struct timeb timestamp; // Time of init. Log calls capture their own time
 } logger;
 
 //////////////////////////////////////////////////////////////////
@@ -34,8 +48,18 @@ logger *logger__init(lgg_conf *params);
 
 void print__log(logger *lgg, log_lvl level, uint16_t line, const char *file, const char *func, const char *fmt, ...);
 
+void print__log__str(logger *lgg, log_lvl level, uint16_t line, const char *file, const char *func, const char *msg, size_t len);
+
+bool log__lvl__enabled(logger *lgg, log_lvl level);
+
 int logger__close(logger *lgg);
 
 void set__log__lvl(logger *lgg, log_lvl level);
 
+void set__atomic__lgg__lvl(logger *lgg, atom_lgg_type type, log_lvl level);
+
+void trace__begin(logger *lgg, const char *name, uint16_t line, const char *file, const char *func);
+
+void trace__end(logger *lgg);
+
 #endif // LOGGER_H
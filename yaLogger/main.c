@@ -27,6 +27,18 @@ Logger TODO:
 #define LOG(lgg, lvl, msg, ...) (print__log((lgg), (lvl), (uint16_t)__LINE__, __FILENAME__, __FUNCTION__, (msg), ## __VA_ARGS__))
 #define LOG_CLOSE(lgg) (logger__close(lgg))
 #define SET_LOG_LVL(lgg, lvl) (set__log__lvl(lgg, lvl))
+#define SET_SINK_LVL(lgg, type, lvl) (set__atomic__lgg__lvl(lgg, type, lvl))
+
+// Thread diagnostic context, added to every line logged by the calling thread
+#define LOG_CONTEXT_SET(key, value) (log_context_set((key), (value)))
+#define LOG_CONTEXT_REMOVE(key) (log_context_remove(key))
+#define LOG_CONTEXT_CLEAR() (log_context_clear())
+
+// Tracing spans. Name must be a string literal or otherwise outlive the logger
+#define LOG_SPAN_BEGIN(lgg, name) (trace__begin((lgg), (name), (uint16_t)__LINE__, __FILENAME__, __FUNCTION__))
+#define LOG_SPAN_END(lgg) (trace__end(lgg))
+// Span around the following statement or block. Leaving it with break, goto or return skips the span end
+#define LOG_SPAN(lgg, name) for (int span__once = (LOG_SPAN_BEGIN(lgg, name), 1); span__once; span__once = (LOG_SPAN_END(lgg), 0))
 
 #include "test.c"
 
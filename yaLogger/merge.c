@@ -0,0 +1,206 @@
+/*
+yal-merge: merge per-thread log files of one run into single time-ordered log.
+
+  yal-merge [-o OUTPUT] <log_path> <log_name> [<n>]
+
+  Merges <log_name>.<n>.t<tid>.log files (and <log_name>.<n>.log, if there's one).
+  Without <n> the last run is merged. Output goes to stdout by default.
+
+Files are read line by line and merged through a heap, so memory use depends only on number of files.
+Lines with equal timestamps keep order of their files. Lines that don't start with timestamp
+(continuation of multiline messages) stay attached to the line before them.
+*/
+
+#include "common.h"
+#include "log_time.h"
+
+#ifdef OS_LINUX
+
+#define MERGE_LINE_LEN 8192
+
+typedef struct {
+    FILE *input;
+    bool has_line;
+    int64_t key;           // Milliseconds since epoch of current line
+    char time_prefix[20];  // Date part of last parsed timestamp, to call mktime once per second
+    time_t time;
+    char line[MERGE_LINE_LEN];
+} merge_reader;
+
+static merge_reader *readers = NULL;
+static int *heap = NULL; // Indices of readers that have lines, ordered by (key, index)
+
+static void usage(void) {
+    fprintf(stderr, "Usage: yal-merge [-o OUTPUT] <log_path> <log_name> [<n>]\n");
+    exit(1);
+}
+
+static bool parse_key(merge_reader *r, int64_t *key) {
+    size_t len = strlen(r->line);
+    time_t time;
+    unsigned ms;
+
+    if (len >= sizeof(r->time_prefix) && memcmp(r->time_prefix, r->line, sizeof(r->time_prefix)) == 0) {
+        if (sscanf(r->line + sizeof(r->time_prefix), ".%u", &ms) != 1)
+            return false;
+        time = r->time;
+    } else {
+        if (!parse_datetime(r->line, len, &time, &ms))
+            return false;
+        memcpy(r->time_prefix, r->line, sizeof(r->time_prefix));
+        r->time = time;
+    }
+    *key = (int64_t)time * 1000 + ms;
+    return true;
+}
+
+static bool line_complete(const char *line) {
+    size_t len = strlen(line);
+    return len > 0 && line[len - 1] == '\n';
+}
+
+// Write current record of reader: its line, rest of the line if it didn't fit the buffer,
+// and continuation lines. Stops at the next line with timestamp, which becomes current
+static void emit_record(merge_reader *r, FILE *output) {
+    bool complete = line_complete(r->line);
+
+    fputs(r->line, output);
+    while ((r->has_line = fgets(r->line, MERGE_LINE_LEN, r->input) != NULL)) {
+        if (complete && parse_key(r, &r->key))
+            return;
+        complete = line_complete(r->line);
+        fputs(r->line, output);
+    }
+}
+
+static bool heap_less(int a, int b) {
+    if (readers[a].key != readers[b].key)
+        return readers[a].key < readers[b].key;
+    return a < b;
+}
+
+static void heap_down(int i) {
+    int n = (int)buf_len(heap);
+
+    for (;;) {
+        int min = i;
+        int l = 2 * i + 1;
+        int r = 2 * i + 2;
+        int tmp;
+
+        if (l < n && heap_less(heap[l], heap[min]))
+            min = l;
+        if (r < n && heap_less(heap[r], heap[min]))
+            min = r;
+        if (min == i)
+            return;
+        tmp = heap[i];
+        heap[i] = heap[min];
+        heap[min] = tmp;
+        i = min;
+    }
+}
+
+// Collect names of files from group num, or from the last group if num is -1
+static char **collect_group(const char *log_path, const char *log_name, uint64_t num) {
+    struct dirent **dirent;
+    char **namelist = NULL;
+    char **group = NULL;
+    int file_num, i;
+
+    file_num = scandir(log_path, &dirent, 0, alphasort);
+    if (file_num < 0)
+        fatal("Can't read directory %s", log_path);
+
+    while (file_num--) {
+        if (starts_with(log_name, dirent[file_num]->d_name) && ends_with(dirent[file_num]->d_name, ".log") &&
+            extract_log_num(dirent[file_num]->d_name) != (uint64_t)-1)
+        {
+            buf_push(namelist, dirent[file_num]->d_name);
+        }
+    }
+    if (buf_len(namelist) == 0)
+        fatal("There're no %s log files in %s", log_name, log_path);
+
+    // Files of a group are ordered by names, so ties between them are resolved the same way every time
+    qsort(namelist, buf_len(namelist), sizeof(char *), lognamecmp);
+    if (num == (uint64_t)-1)
+        num = extract_log_num(namelist[buf_len(namelist) - 1]);
+    for (i = 0; i < buf_len(namelist); i++) {
+        if (extract_log_num(namelist[i]) == num)
+            buf_push(group, namelist[i]);
+    }
+    if (buf_len(group) == 0)
+        fatal("There're no %s log files with number %lu", log_name, num);
+
+    buf_free(namelist);
+    return group;
+}
+
+int main(int argc, char **argv) {
+    const char *output_path = NULL;
+    FILE *output = stdout;
+    uint64_t num = (uint64_t)-1;
+    char path[P_MAX_PATH];
+    char **group;
+    int i, j;
+
+    i = 1;
+    if (i + 1 < argc && strcmp(argv[i], "-o") == 0) {
+        output_path = argv[i + 1];
+        i += 2;
+    }
+    if (argc - i < 2 || argc - i > 3)
+        usage();
+    if (argc - i == 3)
+        num = strtoull(argv[i + 2], NULL, 10);
+
+    group = collect_group(argv[i], argv[i + 1], num);
+    for (j = 0; j < buf_len(group); j++) {
+        snprintf(path, P_MAX_PATH, "%s%s%s", argv[i], ends_with(argv[i], P_PATH_SLASH_STR) ? "" : P_PATH_SLASH_STR, group[j]);
+        if (output_path != NULL && strcmp(path, output_path) == 0)
+            fatal("Output file %s is one of the merged files", output_path);
+
+        buf_push(readers, (merge_reader) { fopen(path, "r") });
+        if (readers[j].input == NULL)
+            fatal("Can't open %s", path);
+    }
+
+    for (i = 0; i < buf_len(readers); i++) {
+        merge_reader *r = &readers[i];
+
+        r->has_line = fgets(r->line, MERGE_LINE_LEN, r->input) != NULL;
+        if (!r->has_line)
+            continue;
+        // Lines before the first timestamp go first
+        if (!parse_key(r, &r->key))
+            r->key = INT64_MIN;
+        buf_push(heap, i);
+    }
+    for (i = (int)buf_len(heap) / 2 - 1; i >= 0; i--)
+        heap_down(i);
+
+    if (output_path != NULL && (output = fopen(output_path, "w")) == NULL)
+        fatal("Can't open %s", output_path);
+
+    while (buf_len(heap) > 0) {
+        merge_reader *r = &readers[heap[0]];
+
+        emit_record(r, output);
+        if (!r->has_line)
+            heap[0] = heap[--buf__hdr(heap)->len];
+        heap_down(0);
+    }
+
+    for (i = 0; i < buf_len(readers); i++)
+        fclose(readers[i].input);
+    return fclose(output);
+}
+
+#else
+
+int main(int argc, char **argv) {
+    fatal("yal-merge is supported only on Linux");
+}
+
+#endif
@@ -10,6 +10,7 @@
 #include <windows.h>
 #include <tchar.h>
 #include <direct.h>
+#include <io.h>
 #include <sys\timeb.h>
 
 // Platform-independent macros
@@ -18,6 +19,36 @@
 #define P_PATH_SLASH_STR "\\"
 #define p_getcwd _getcwd
 #define p_ftime _ftime
+#define p_localtime(time, tm) localtime_s((tm), (time))
+
+// Atomic pointer operations (full barriers on Windows)
+#define p_atomic_load_ptr(pp) InterlockedCompareExchangePointer((PVOID volatile *)(pp), NULL, NULL)
+#define p_atomic_store_ptr(pp, v) ((void)InterlockedExchangePointer((PVOID volatile *)(pp), (v)))
+
+// Low-level output and locking
+#define p_fileno _fileno
+#define p_isatty _isatty
+#define p_write(fd, data, len) _write((fd), (data), (unsigned int)(len))
+#define p_fwrite_unlocked _fwrite_nolock
+#define p_flockfile _lock_file
+#define p_funlockfile _unlock_file
+
+// Raw return addresses of calling thread, innermost first
+#define p_backtrace(frames, n) ((int)CaptureStackBackTrace(0, (DWORD)(n), (frames), NULL))
+
+#define p_thread_local __declspec(thread)
+#define p_getpid() ((uint32_t)GetCurrentProcessId())
+#define p_gettid() ((uint32_t)GetCurrentThreadId())
+
+typedef SRWLOCK p_mutex;
+#define P_MUTEX_INITIALIZER SRWLOCK_INIT
+#define p_mutex_lock AcquireSRWLockExclusive
+#define p_mutex_unlock ReleaseSRWLockExclusive
+
+// Thread-local value with destructor, called on thread exit if value isn't NULL
+typedef DWORD p_thread_key;
+#define p_thread_key_create(key, destructor) ((*(key) = FlsAlloc((PFLS_CALLBACK_FUNCTION)(destructor))) != FLS_OUT_OF_INDEXES)
+#define p_thread_key_set(key, value) FlsSetValue((key), (value))
 
 #elif defined(__linux__) || defined(__gnu_linux__)
 
@@ -26,6 +57,10 @@
 // Linux specific headers
 #include <unistd.h>
 #include <dirent.h>
+#include <poll.h>
+#include <pthread.h>
+#include <execinfo.h>
+#include <sys/syscall.h>
 #include <sys/timeb.h>
 #include <sys/stat.h>
 #include <linux/limits.h>
@@ -36,6 +71,36 @@
 #define P_PATH_SLASH_STR "/"
 #define p_getcwd getcwd
 #define p_ftime ftime
+#define p_localtime(time, tm) localtime_r((time), (tm))
+
+// Atomic pointer operations
+#define p_atomic_load_ptr(pp) __atomic_load_n((pp), __ATOMIC_ACQUIRE)
+#define p_atomic_store_ptr(pp, v) __atomic_store_n((pp), (v), __ATOMIC_RELEASE)
+
+// Low-level output and locking
+#define p_fileno fileno
+#define p_isatty isatty
+#define p_write write
+#define p_fwrite_unlocked fwrite_unlocked
+#define p_flockfile flockfile
+#define p_funlockfile funlockfile
+
+// Raw return addresses of calling thread, innermost first
+#define p_backtrace(frames, n) backtrace((frames), (n))
+
+#define p_thread_local __thread
+#define p_getpid() ((uint32_t)getpid())
+#define p_gettid() ((uint32_t)syscall(SYS_gettid))
+
+typedef pthread_mutex_t p_mutex;
+#define P_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define p_mutex_lock pthread_mutex_lock
+#define p_mutex_unlock pthread_mutex_unlock
+
+// Thread-local value with destructor, called on thread exit if value isn't NULL
+typedef pthread_key_t p_thread_key;
+#define p_thread_key_create(key, destructor) (pthread_key_create((key), (destructor)) == 0)
+#define p_thread_key_set(key, value) pthread_setspecific((key), (value))
 
 
 #elif defined(__APPLE__) || defined(__MACH__)
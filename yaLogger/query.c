@@ -0,0 +1,284 @@
+/*
+yal-query: print lines of <log_name>.<n>.log files that fit time range and level filter.
+
+  yal-query [-from TIME] [-to TIME] [-level LVL] <log_path> <log_name>
+
+  TIME is seconds since epoch or local "YYYY-MM-DD HH:MM:SS", both ends are inclusive.
+  LVL is level name as it's printed in log (e.g. WARN), lines with this or more severe level are printed.
+  Lines without timestamp (stack traces, multiline messages) go with the line before them.
+
+Files are memory-mapped and scanned in parallel, output is in log numbers order.
+If file has .idx sidecar (lgg_conf.write_index), only buckets that fit filter are scanned.
+*/
+
+#include "common.h"
+#include "log_levels.h"
+#include "log_index.h"
+#include "log_time.h"
+
+#ifdef OS_LINUX
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#define QUERY_MAX_THREADS 8
+#define TIME_UNKNOWN INT64_MIN
+
+typedef struct {
+    uint64_t begin;
+    uint64_t end;
+} byte_range;
+
+typedef struct {
+    char *path;
+    const char *data;
+    size_t size;
+    byte_range *match_buf; // Ranges of matched lines, adjacent lines are coalesced
+} query_file;
+
+static struct {
+    int64_t from;
+    int64_t to;
+    uint32_t level_mask;
+} filter = { INT64_MIN, INT64_MAX, (1u << (UNKNOWN_L + 1)) - 1 };
+
+static query_file *files = NULL;
+static int next_file = 0;
+
+static void usage(void) {
+    fprintf(stderr, "Usage: yal-query [-from TIME] [-to TIME] [-level LVL] <log_path> <log_name>\n");
+    exit(1);
+}
+
+static int64_t parse_time_arg(const char *arg) {
+    struct tm tm = { 0 };
+    char *end;
+    int64_t value = strtoll(arg, &end, 10);
+
+    if (*end == '\0')
+        return value;
+
+    if (sscanf(arg, "%d-%d-%d%*c%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+        fatal("Can't parse time '%s'", arg);
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+// Level by its name, e.g. "WARN". Returns false if there's no such level
+static bool parse_level(const char *str, size_t len, log_lvl *level) {
+    int lvl;
+
+    for (lvl = FATAL_L; lvl <= UNKNOWN_L; lvl++) {
+        const char *name = log_level_to_str(lvl);
+        if (strlen(name) == len && memcmp(name, str, len) == 0) {
+            *level = lvl;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parse "2019 Apr 29 20:01:18.615" at the start of line. Returns TIME_UNKNOWN on failure
+static int64_t parse_line_time(const char *line, size_t len) {
+    time_t time;
+    unsigned ms;
+
+    if (!parse_datetime(line, len, &time, &ms))
+        return TIME_UNKNOWN;
+    return time;
+}
+
+// Parse level tag "[WARN ]" that follows timestamp
+static log_lvl parse_line_level(const char *line, size_t len) {
+    const char *open = memchr(line, '[', len);
+    const char *close;
+    size_t tag_len;
+    log_lvl level;
+
+    if (open == NULL)
+        return UNKNOWN_L;
+    close = memchr(open, ']', len - (open - line));
+    if (close == NULL)
+        return UNKNOWN_L;
+    tag_len = close - open - 1;
+    while (tag_len > 0 && open[tag_len] == ' ')
+        tag_len--;
+    return parse_level(open + 1, tag_len, &level) ? level : UNKNOWN_L;
+}
+
+static void add_match(query_file *qf, uint64_t begin, uint64_t end) {
+    if (buf_len(qf->match_buf) > 0 && qf->match_buf[buf_len(qf->match_buf) - 1].end == begin)
+        qf->match_buf[buf_len(qf->match_buf) - 1].end = end;
+    else
+        buf_push(qf->match_buf, (byte_range) { begin, end });
+}
+
+static bool record_matches(int64_t time, log_lvl level) {
+    return time >= filter.from && time <= filter.to && (filter.level_mask & (1u << level));
+}
+
+// Filter records in [begin, end), which starts at record boundary. Record is a line with timestamp
+// and lines without it that follow (stack trace, multiline message), they're matched together
+static void scan_region(query_file *qf, uint64_t begin, uint64_t end) {
+    const char *prev_line = NULL; // Last line with timestamp
+    int64_t prev_time = TIME_UNKNOWN;
+    // Lines before the first timestamp are matched as record of unknown time and level
+    bool matched = record_matches(TIME_UNKNOWN, UNKNOWN_L);
+
+    while (begin < end) {
+        const char *line = qf->data + begin;
+        const char *nl = memchr(line, '\n', end - begin);
+        uint64_t line_end = nl ? (nl - qf->data) + 1 : end;
+        size_t len = line_end - begin;
+        int64_t time;
+
+        // Lines of one second share first 20 characters, so mktime is called once per second
+        if (prev_line != NULL && len >= 20 && memcmp(prev_line, line, 20) == 0)
+            time = prev_time;
+        else
+            time = parse_line_time(line, len);
+
+        if (time != TIME_UNKNOWN) {
+            prev_line = line;
+            prev_time = time;
+            matched = record_matches(time, parse_line_level(line, len));
+        }
+        if (matched)
+            add_match(qf, begin, line_end);
+        begin = line_end;
+    }
+}
+
+static void scan_file(query_file *qf) {
+    lgg_idx_entry *entries = lgg_index_load(qf->path);
+    uint64_t tail = 0;
+    int i;
+
+    for (i = 0; i < buf_len(entries); i++) {
+        lgg_idx_entry *e = &entries[i];
+
+        // Index can't point past the end of file, unless file was replaced
+        if (e->offset != tail || e->offset + e->len > qf->size)
+            break;
+        tail = e->offset + e->len;
+
+        if (e->time < filter.from || e->time > filter.to || !(e->level_mask & filter.level_mask))
+            continue;
+        scan_region(qf, e->offset, e->offset + e->len);
+    }
+
+    // Not indexed part: whole file without index, or last bucket that wasn't flushed
+    scan_region(qf, tail, qf->size);
+    buf_free(entries);
+}
+
+static void *query_worker(void *arg) {
+    int i;
+
+    while ((i = __atomic_fetch_add(&next_file, 1, __ATOMIC_RELAXED)) < buf_len(files))
+        scan_file(&files[i]);
+    return NULL;
+}
+
+static void map_file(query_file *qf) {
+    struct stat st;
+    int fd = open(qf->path, O_RDONLY);
+
+    qf->data = NULL;
+    qf->size = 0;
+    qf->match_buf = NULL;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "yal-query: can't open %s\n", qf->path);
+    } else if (st.st_size > 0) {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "yal-query: can't map %s\n", qf->path);
+        } else {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            qf->data = data;
+            qf->size = st.st_size;
+        }
+    }
+    if (fd >= 0)
+        close(fd);
+}
+
+static void collect_files(const char *log_path, const char *log_name) {
+    struct dirent **dirent;
+    char **namelist = NULL;
+    char path[P_MAX_PATH];
+    int file_num, i;
+
+    file_num = scandir(log_path, &dirent, 0, alphasort);
+    if (file_num < 0)
+        fatal("Can't read directory %s", log_path);
+
+    while (file_num--) {
+        if (starts_with(log_name, dirent[file_num]->d_name) && ends_with(dirent[file_num]->d_name, ".log") &&
+            extract_log_num(dirent[file_num]->d_name) != (uint64_t)-1)
+        {
+            buf_push(namelist, dirent[file_num]->d_name);
+        }
+    }
+    qsort(namelist, buf_len(namelist), sizeof(char *), lognamecmp);
+
+    for (i = 0; i < buf_len(namelist); i++) {
+        snprintf(path, P_MAX_PATH, "%s%s%s", log_path, ends_with(log_path, P_PATH_SLASH_STR) ? "" : P_PATH_SLASH_STR, namelist[i]);
+        buf_push(files, (query_file) { strdup(path) });
+        map_file(&files[buf_len(files) - 1]);
+    }
+    buf_free(namelist);
+}
+
+int main(int argc, char **argv) {
+    pthread_t threads[QUERY_MAX_THREADS];
+    int thread_num, i, j;
+    log_lvl level;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i += 2) {
+        if (i + 1 >= argc)
+            usage();
+        if (strcmp(argv[i], "-from") == 0)
+            filter.from = parse_time_arg(argv[i + 1]);
+        else if (strcmp(argv[i], "-to") == 0)
+            filter.to = parse_time_arg(argv[i + 1]);
+        else if (strcmp(argv[i], "-level") == 0) {
+            if (!parse_level(argv[i + 1], strlen(argv[i + 1]), &level))
+                fatal("Unknown level '%s'", argv[i + 1]);
+            filter.level_mask = (1u << (level + 1)) - 1;
+        }
+        else
+            usage();
+    }
+    if (argc - i != 2)
+        usage();
+
+    collect_files(argv[i], argv[i + 1]);
+
+    thread_num = (int)MIN(buf_len(files), QUERY_MAX_THREADS);
+    for (i = 0; i < thread_num; i++) {
+        if (pthread_create(&threads[i], NULL, query_worker, NULL) != 0)
+            fatal("Can't start worker thread");
+    }
+    for (i = 0; i < thread_num; i++)
+        pthread_join(threads[i], NULL);
+
+    for (i = 0; i < buf_len(files); i++) {
+        for (j = 0; j < buf_len(files[i].match_buf); j++) {
+            byte_range *r = &files[i].match_buf[j];
+            fwrite(files[i].data + r->begin, 1, r->end - r->begin, stdout);
+        }
+    }
+    return 0;
+}
+
+#else
+
+int main(int argc, char **argv) {
+    fatal("yal-query is supported only on Linux");
+}
+
+#endif
@@ -21,7 +21,7 @@ void atomic_loggers_test() {
     CONSOLE_TEST(INFO_L, "One more test message. This is info");
     CONSOLE_TEST(DEBUG_L, "Yes. Test message. The last one. This time debug");
 
-    if (file_lgg_init(TEST__MODE ? log_path : p_getcwd(NULL, 0), "testlog", 0)) {
+    if (file_lgg_init(TEST__MODE ? log_path : p_getcwd(NULL, 0), "testlog", 0, false, false)) {
         fatal("Atomic file logger init error");
     }
     FILE_TEST(ERROR_L, "Just a test message. Error! Praise yourselves!");
@@ -52,6 +52,136 @@ void logger_test() {
     LOG_CLOSE(lgg);
 }
 
+void sink_levels_test() {
+    logger *lgg = LOG_INIT(&(lgg_conf) { log_path, log_name, UNKNOWN_L, 4 });
+    SET_SINK_LVL(lgg, CONSOLE_LGG, ERROR_L);
+    LOG(lgg, ERROR_L, "Goes to console and file");
+    LOG(lgg, INFO_L, "Goes to file only");
+    SET_LOG_LVL(lgg, WARN_L);
+    LOG(lgg, INFO_L, "Goes nowhere");
+    LOG(lgg, WARN_L, "Goes to file only");
+
+    LOG_CLOSE(lgg);
+}
+
+// Check result with: yal-query -level WARN <log_path> <log_name>
+void index_test() {
+    int i;
+    logger *lgg = LOG_INIT(&(lgg_conf) { log_path, log_name, UNKNOWN_L, 4, true });
+    SET_SINK_LVL(lgg, CONSOLE_LGG, FATAL_L);
+    for (i = 0; i < 100000; i++)
+        LOG(lgg, i % 1000 ? DEBUG_L : WARN_L, "Message number %d", i);
+
+    LOG_CLOSE(lgg);
+}
+
+// Run with slow reader, e.g. yaLogger | (sleep 1; cat), to see dropped lines report
+void console_test() {
+    int i;
+    logger *lgg = LOG_INIT(&(lgg_conf) { log_path, log_name, UNKNOWN_L, 4, false, CONSOLE_COLOR | CONSOLE_STDERR | CONSOLE_NONBLOCK });
+    LOG(lgg, ERROR_L, "This goes to stderr");
+    for (i = 0; i < 100000; i++)
+        LOG(lgg, INFO_L, "Message number %d", i);
+
+    LOG_CLOSE(lgg);
+}
+
+// Throughput of the whole logging path, file logger only
+void bench_test() {
+    const int n = 1000000;
+    int i;
+    clock_t start;
+    logger *lgg = LOG_INIT(&(lgg_conf) { log_path, log_name, UNKNOWN_L, 4 });
+    SET_SINK_LVL(lgg, CONSOLE_LGG, FATAL_L);
+
+    start = clock();
+    for (i = 0; i < n; i++)
+        LOG(lgg, INFO_L, "Message: %s, %d", "string", i);
+    printf("%d lines in %.3f s\n", n, (double)(clock() - start) / CLOCKS_PER_SEC);
+
+    LOG_CLOSE(lgg);
+}
+
+// Open <log_name>.<n>.trace.json in chrome://tracing or ui.perfetto.dev
+void trace_test() {
+    int i, j;
+    logger *lgg = LOG_INIT(&(lgg_conf) { log_path, log_name, UNKNOWN_L, 4, false, 0, 2 });
+
+    for (i = 0; i < 10; i++) {
+        LOG_SPAN(lgg, "outer") {
+            LOG(lgg, INFO_L, "Outer span %d", i);
+            for (j = 0; j < 3; j++) {
+                LOG_SPAN_BEGIN(lgg, "inner");
+                LOG(lgg, DEBUG_L, "Inner span %d", j);
+                LOG_SPAN_END(lgg);
+            }
+        }
+    }
+
+    LOG_CLOSE(lgg);
+}
+
+void context_test() {
+    logger *lgg = LOG_INIT(&(lgg_conf) { log_path, log_name, UNKNOWN_L, 4 });
+    LOG(lgg, INFO_L, "No context yet");
+    LOG_CONTEXT_SET("req", "42");
+    LOG_CONTEXT_SET("tenant", "acme");
+    LOG(lgg, INFO_L, "Request and tenant");
+    LOG_CONTEXT_SET("req", "43");
+    LOG(lgg, INFO_L, "Next request");
+    LOG_CONTEXT_REMOVE("req");
+    LOG(lgg, INFO_L, "Tenant only");
+    LOG_CONTEXT_CLEAR();
+    LOG(lgg, INFO_L, "No context again");
+
+    LOG_CLOSE(lgg);
+}
+
+void stack_test_fail(logger *lgg, int attempt) {
+    LOG(lgg, ERROR_L, "Attempt %d failed", attempt);
+}
+
+void stack_test() {
+    logger *lgg = LOG_INIT(&(lgg_conf) { log_path, log_name, UNKNOWN_L, 4, false, 0, 0, false, true });
+    int i;
+
+    // Symbols are written with the first line only, other lines just refer to the same stack
+    for (i = 0; i < 3; i++)
+        stack_test_fail(lgg, i);
+    LOG(lgg, CRIT_L, "Different stack");
+    LOG(lgg, WARN_L, "Not severe enough for stack");
+
+    LOG_CLOSE(lgg);
+}
+
+#ifdef OS_LINUX
+
+static void *per_thread_worker(void *arg) {
+    logger *lgg = (logger *)arg;
+    int i;
+
+    for (i = 0; i < 1000; i++)
+        LOG(lgg, INFO_L, "Message number %d", i);
+    return NULL;
+}
+
+// Check result with: yal-merge <log_path> <log_name>
+void per_thread_test() {
+    pthread_t threads[4];
+    int i;
+    logger *lgg = LOG_INIT(&(lgg_conf) { log_path, log_name, UNKNOWN_L, 4, false, 0, 0, true });
+    SET_SINK_LVL(lgg, CONSOLE_LGG, FATAL_L);
+
+    for (i = 0; i < 4; i++)
+        pthread_create(&threads[i], NULL, per_thread_worker, lgg);
+    for (i = 0; i < 4; i++)
+        pthread_join(threads[i], NULL);
+
+    LOG_CLOSE(lgg);
+}
+
+#endif
+
 #define TEST_FUNC(func, ...) (printf("%s(%s):\n\t= %d\n\n", #func, (#__VA_ARGS__), func(__VA_ARGS__)))
 
 void test_extract_log_num() {
@@ -70,4 +200,12 @@ void test_main(void) {
     //test_extract_log_num();
     //atomic_loggers_test();
     logger_test();
+    //sink_levels_test();
+    //index_test();
+    //console_test();
+    //bench_test();
+    //trace_test();
+    //per_thread_test();
+    //context_test();
+    //stack_test();
 }
@@ -0,0 +1,37 @@
+// C++ front end check: each YAL_LOG line is followed by the same line logged through C API, they must be equal
+
+#include "yal.hpp"
+
+#define C_LOG(lgg, lvl, msg, ...) (print__log((lgg), (lvl), (uint16_t)__LINE__, "test_cpp.cpp", __FUNCTION__, (msg), ## __VA_ARGS__))
+
+enum request_kind { GET_REQUEST = 1, PUT_REQUEST };
+
+void cpp_test() {
+    logger *lgg = logger__init(NULL);
+    std::string user = "cromvell";
+    std::string_view path = "/index.html";
+
+    YAL_LOG(lgg, INFO_L, "Plain text, 100%% literal");
+    C_LOG(lgg, INFO_L, "Plain text, 100%% literal");
+    YAL_LOG(lgg, INFO_L, "Request %d (%u) from %s to %s took %.3f ms", 42, PUT_REQUEST, user, path, 1.5);
+    C_LOG(lgg, INFO_L, "Request %d (%u) from %s to %s took %.3f ms", 42, PUT_REQUEST, user.c_str(), "/index.html", 1.5);
+    YAL_LOG(lgg, WARN_L, "%ld %lu %x %X %o %c %i", -1234567890123L, 18446744073709551615UL, -1, 255, 8, 'y', -0);
+    C_LOG(lgg, WARN_L, "%ld %lu %x %X %o %c %i", -1234567890123L, 18446744073709551615UL, -1, 255, 8, 'y', -0);
+    YAL_LOG(lgg, ERROR_L, "[%5d] [%-5d] [%05x] [%+d] [%#o] [%8.2e] [%-10s] [%.3s] [%g]", 7, 7, 0xab, 3, 8, 12345.678, user, "abcdef", 0.1);
+    C_LOG(lgg, ERROR_L, "[%5d] [%-5d] [%05x] [%+d] [%#o] [%8.2e] [%-10s] [%.3s] [%g]", 7, 7, 0xab, 3, 8, 12345.678, user.c_str(), "abcdef", 0.1);
+    YAL_LOG(lgg, INFO_L, "[%5c] [%-3c] [%c]", 'a', 'b', 'c');
+    C_LOG(lgg, INFO_L, "[%5c] [%-3c] [%c]", 'a', 'b', 'c');
+    YAL_LOG(lgg, INFO_L, "%c|null character is kept", 0);
+    C_LOG(lgg, INFO_L, "%c|null character is kept", 0);
+    YAL_LOG(lgg, DEBUG_L, "%hhd %hd %lld %zu %p %s", (signed char)-5, (short)-300, -1LL, sizeof(int), (void *)lgg, (const char *)NULL);
+    C_LOG(lgg, DEBUG_L, "%hhd %hd %lld %zu %p %s", (signed char)-5, (short)-300, -1LL, sizeof(int), (void *)lgg, "(null)");
+    // Doesn't compile: format and argument types don't match
+    //YAL_LOG(lgg, INFO_L, "%d %s", "one", 2);
+
+    logger__close(lgg);
+}
+
+int main(int argc, char **argv) {
+    cpp_test();
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include "trace.h"
+
+static FILE *trace_lgg_output = NULL; // Output file handle, tracing is off if it's NULL
+static int trace_lgg_sampling = 1;    // Record one of this many top-level spans
+static uint64_t trace_lgg_start;      // Monotonic time of init, timestamps are relative to it
+static bool trace_lgg_first;          // No events written yet, so no separating comma needed
+static trace_buf **trace_bufs = NULL; // Buffers of running threads that traced, protected by lock
+static unsigned trace_lgg_generation = 0; // Changes on close, when all buffers are freed
+static p_mutex trace_lgg_lock = P_MUTEX_INITIALIZER;
+
+// Buffer of finished thread is flushed and freed by key destructor
+static p_thread_key trace_buf_key;
+static bool trace_buf_key_created = false;
+
+static p_thread_local trace_buf *thread_buf = NULL;
+static p_thread_local unsigned thread_buf_generation = 0;
+
+// Names come from source code, but quotes and backslashes still can't go into JSON as is
+static void write_json_str(const char *str) {
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\')
+            fputc('\\', trace_lgg_output);
+        fputc(*str, trace_lgg_output);
+    }
+}
+
+// Call under lock
+static void trace_flush(trace_buf *tb) {
+    size_t i;
+    uint32_t pid = p_getpid();
+
+    for (i = 0; i < tb->len; i++) {
+        trace_event *e = &tb->events[i];
+        uint64_t ts = e->time - trace_lgg_start;
+
+        fputs(trace_lgg_first ? "\n" : ",\n", trace_lgg_output);
+        trace_lgg_first = false;
+        if (e->name == NULL) {
+            fprintf(trace_lgg_output, "{\"ph\":\"E\",\"ts\":%llu.%03u,\"pid\":%u,\"tid\":%u}",
+                    (unsigned long long)(ts / 1000), (unsigned)(ts % 1000), pid, tb->tid);
+        } else {
+            fputs("{\"name\":\"", trace_lgg_output);
+            write_json_str(e->name);
+            fprintf(trace_lgg_output, "\",\"cat\":\"yal\",\"ph\":\"B\",\"ts\":%llu.%03u,\"pid\":%u,\"tid\":%u,\"args\":{\"file\":\"",
+                    (unsigned long long)(ts / 1000), (unsigned)(ts % 1000), pid, tb->tid);
+            write_json_str(e->file);
+            fprintf(trace_lgg_output, "\",\"line\":%u,\"func\":\"", e->line);
+            write_json_str(e->func);
+            fputs("\"}}", trace_lgg_output);
+        }
+    }
+    tb->len = 0;
+}
+
+int trace_lgg_init(const char *log_file, int sampling) {
+    char path[P_MAX_PATH];
+    FILE *output;
+
+    trace_lgg_close();
+    log_sidecar_path(path, log_file, TRACE_EXT);
+    output = fopen(path, "w");
+    if (output == NULL) {
+        return 1;
+    }
+
+    p_mutex_lock(&trace_lgg_lock);
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", output);
+    trace_lgg_sampling = MAX(sampling, 1);
+    trace_lgg_start = monotonic_ns();
+    trace_lgg_first = true;
+    p_atomic_store_ptr(&trace_lgg_output, output);
+    p_mutex_unlock(&trace_lgg_lock);
+
+    return 0;
+}
+
+// Buffer of calling thread, NULL if it has none or it was freed by close
+static trace_buf *current_thread_buf(void) {
+    return thread_buf_generation == trace_lgg_generation ? thread_buf : NULL;
+}
+
+// Runs in exiting thread. Key value may point to buffer that close already freed, so thread's own state is checked
+static void free_thread_buf(void *arg) {
+    trace_buf *tb;
+    int i;
+
+    p_mutex_lock(&trace_lgg_lock);
+    tb = current_thread_buf();
+    if (tb != NULL) {
+        if (trace_lgg_output != NULL)
+            trace_flush(tb);
+        for (i = 0; i < buf_len(trace_bufs); i++) {
+            if (trace_bufs[i] == tb) {
+                trace_bufs[i] = trace_bufs[--buf__hdr(trace_bufs)->len];
+                break;
+            }
+        }
+        free(tb);
+        thread_buf = NULL;
+    }
+    p_mutex_unlock(&trace_lgg_lock);
+}
+
+static trace_buf *get_thread_buf(void) {
+    trace_buf *tb = current_thread_buf();
+
+    if (tb == NULL) {
+        tb = (trace_buf *)xmalloc(sizeof(trace_buf));
+        tb->tid = p_gettid();
+        tb->depth = 0;
+        tb->skip = false;
+        tb->counter = 0;
+        tb->len = 0;
+
+        p_mutex_lock(&trace_lgg_lock);
+        if (!trace_buf_key_created)
+            trace_buf_key_created = p_thread_key_create(&trace_buf_key, free_thread_buf);
+        if (trace_buf_key_created)
+            p_thread_key_set(trace_buf_key, tb);
+        buf_push(trace_bufs, tb);
+        thread_buf = tb;
+        thread_buf_generation = trace_lgg_generation;
+        p_mutex_unlock(&trace_lgg_lock);
+    }
+    return tb;
+}
+
+static void trace_push(trace_buf *tb, trace_event event) {
+    if (tb->len == TRACE_BUF_EVENTS) {
+        p_mutex_lock(&trace_lgg_lock);
+        if (trace_lgg_output != NULL)
+            trace_flush(tb);
+        else
+            tb->len = 0;
+        p_mutex_unlock(&trace_lgg_lock);
+    }
+    tb->events[tb->len++] = event;
+}
+
+void trace_lgg_begin(const char *name, uint16_t line, const char *file, const char *func) {
+    bool on = p_atomic_load_ptr(&trace_lgg_output) != NULL;
+    trace_buf *tb;
+
+    // Thread that never traced has no open spans to keep balanced
+    if (!on && current_thread_buf() == NULL)
+        return;
+
+    tb = get_thread_buf();
+    // Sampling decision is made for top-level spans, nested spans follow it, so sampled trees are complete
+    if (tb->depth++ == 0)
+        tb->skip = !on || (tb->counter++ % trace_lgg_sampling) != 0;
+    if (!tb->skip && on)
+        trace_push(tb, (trace_event) { name, file, func, monotonic_ns(), line });
+}
+
+void trace_lgg_end(void) {
+    trace_buf *tb = current_thread_buf();
+
+    // Span was started before this thread ever traced
+    if (tb == NULL || tb->depth == 0)
+        return;
+
+    tb->depth--;
+    if (!tb->skip && p_atomic_load_ptr(&trace_lgg_output) != NULL)
+        trace_push(tb, (trace_event) { NULL, NULL, NULL, monotonic_ns(), 0 });
+}
+
+// Other threads must not trace during close. Their buffers are freed, threads get new ones on next span
+int trace_lgg_close() {
+    int i, result;
+
+    p_mutex_lock(&trace_lgg_lock);
+    if (trace_lgg_output == NULL) {
+        p_mutex_unlock(&trace_lgg_lock);
+        return 0;
+    }
+    for (i = 0; i < buf_len(trace_bufs); i++) {
+        trace_flush(trace_bufs[i]);
+        free(trace_bufs[i]);
+    }
+    buf_free(trace_bufs);
+    trace_lgg_generation++;
+    fputs("\n]}\n", trace_lgg_output);
+    result = fclose(trace_lgg_output);
+    p_atomic_store_ptr(&trace_lgg_output, NULL);
+    p_mutex_unlock(&trace_lgg_lock);
+
+    return result;
+}
@@ -0,0 +1,37 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "common.h"
+#include "log_time.h"
+
+//////////////////////////////////////////////////////////////////
+// Trace logger: records begin and end of spans into per-thread buffers
+// and exports them as Chrome trace event JSON (chrome://tracing, Perfetto).
+// Trace of <name>.<n>.log is written to <name>.<n>.trace.json
+
+#define TRACE_EXT ".trace.json"
+#define TRACE_BUF_EVENTS 4096
+
+typedef struct {
+    const char *name; // NULL for end of span
+    const char *file;
+    const char *func;
+    uint64_t time;    // monotonic_ns()
+    uint16_t line;
+} trace_event;
+
+typedef struct {
+    uint32_t tid;
+    int depth;        // Number of open spans
+    bool skip;        // Current top-level span and everything nested in it isn't sampled
+    uint32_t counter; // Top-level spans started, for sampling
+    size_t len;
+    trace_event events[TRACE_BUF_EVENTS];
+} trace_buf;
+
+extern int trace_lgg_init(const char *log_file, int sampling);
+extern void trace_lgg_begin(const char *name, uint16_t line, const char *file, const char *func);
+extern void trace_lgg_end(void);
+extern int trace_lgg_close();
+
+#endif // TRACE_H
@@ -0,0 +1,333 @@
+#ifndef YAL_HPP
+#define YAL_HPP
+
+//////////////////////////////////////////////////////////////////
+// Type-safe C++ front end (C++17, header only)
+//
+//   YAL_LOG(lgg, INFO_L, "Request %d from %s took %.3f ms", id, user, ms);
+//
+// Format must be a string literal. It's parsed at compile time and checked against
+// argument types, so mismatch is a compile error instead of undefined behavior.
+// Every call site gets its own serializer: text between conversions is copied with
+// lengths known at compile time, integers, chars and strings are rendered directly,
+// only floats and conversions with flags, width or precision go through snprintf.
+// Length modifiers (l, ll, z, ...) are accepted and ignored, since real argument types are known.
+// Conversions with * width or precision and %n aren't supported.
+//
+// C API (LOG, print__log, sinks) keeps working alongside, both log through the same sinks.
+
+extern "C" {
+#include "logger.h"
+}
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace yal {
+namespace detail {
+
+struct spec {
+    std::size_t begin; // Position of '%'
+    std::size_t end;   // Position after conversion character
+    char conv;         // Conversion character, '%' for "%%", 0 if conversion is malformed or not supported
+    bool plain;        // No flags, width or precision
+};
+
+constexpr bool is_flag(char c) { return c == '-' || c == '+' || c == ' ' || c == '#' || c == '0'; }
+constexpr bool is_digit(char c) { return c >= '0' && c <= '9'; }
+constexpr bool is_length(char c) { return c == 'h' || c == 'l' || c == 'L' || c == 'j' || c == 'z' || c == 't'; }
+
+constexpr bool is_conv(char c) {
+    for (const char *p = "diuoxXcspfFeEgGaA"; *p; p++) {
+        if (*p == c)
+            return true;
+    }
+    return false;
+}
+
+constexpr std::size_t next_spec(const char *fmt, std::size_t pos) {
+    while (fmt[pos] != '\0' && fmt[pos] != '%')
+        pos++;
+    return pos;
+}
+
+// Parse conversion that starts at fmt[pos] == '%'
+constexpr spec parse_spec(const char *fmt, std::size_t pos) {
+    spec s = { pos, pos + 1, 0, true };
+    std::size_t i = pos + 1;
+
+    if (fmt[i] == '%')
+        return { pos, i + 1, '%', true };
+    while (is_flag(fmt[i])) {
+        s.plain = false;
+        i++;
+    }
+    while (is_digit(fmt[i])) {
+        s.plain = false;
+        i++;
+    }
+    if (fmt[i] == '.') {
+        s.plain = false;
+        i++;
+        while (is_digit(fmt[i]))
+            i++;
+    }
+    while (is_length(fmt[i]))
+        i++;
+    if (is_conv(fmt[i])) {
+        s.conv = fmt[i];
+        s.end = i + 1;
+    }
+    return s;
+}
+
+template <class T> using bare = std::remove_cv_t<std::remove_reference_t<T>>;
+
+template <class T> constexpr bool is_string_v =
+    std::is_same_v<std::decay_t<T>, char *> || std::is_same_v<std::decay_t<T>, const char *> ||
+    std::is_same_v<bare<T>, std::string> || std::is_same_v<bare<T>, std::string_view>;
+
+template <class T> constexpr bool is_integer_v = std::is_integral_v<bare<T>> || std::is_enum_v<bare<T>>;
+
+template <class T>
+constexpr bool accepts(char conv) {
+    switch (conv) {
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+        return is_integer_v<T>;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        return std::is_floating_point_v<bare<T>>;
+    case 's':
+        return is_string_v<T>;
+    case 'p':
+        return std::is_pointer_v<std::decay_t<T>> || std::is_null_pointer_v<bare<T>>;
+    default:
+        return false;
+    }
+}
+
+// Check that every conversion of fmt from pos has an argument of suitable type and vice versa
+template <class... Args> struct checker;
+
+template <> struct checker<> {
+    static constexpr bool check(const char *fmt, std::size_t pos) {
+        for (pos = next_spec(fmt, pos); fmt[pos] != '\0'; pos = next_spec(fmt, pos)) {
+            spec s = parse_spec(fmt, pos);
+            if (s.conv != '%')
+                return false;
+            pos = s.end;
+        }
+        return true;
+    }
+};
+
+template <class T, class... Rest> struct checker<T, Rest...> {
+    static constexpr bool check(const char *fmt, std::size_t pos) {
+        pos = next_spec(fmt, pos);
+        if (fmt[pos] == '\0')
+            return false;
+
+        spec s = parse_spec(fmt, pos);
+        if (s.conv == '%')
+            return checker<T, Rest...>::check(fmt, s.end);
+        return accepts<T>(s.conv) && checker<Rest...>::check(fmt, s.end);
+    }
+};
+
+// Conversion spec for snprintf: user's flags, width and precision with length modifier for converted argument
+struct printf_spec {
+    char str[32];
+};
+
+template <class Fmt, std::size_t Pos>
+constexpr printf_spec make_printf_spec(bool wide_int) {
+    constexpr spec s = parse_spec(Fmt::str(), Pos);
+    static_assert(s.end - s.begin < sizeof(printf_spec::str) - 3, "Log format conversion is too long");
+    printf_spec out = {};
+    std::size_t n = 0;
+
+    for (std::size_t i = s.begin; i < s.end - 1; i++) {
+        if (!is_length(Fmt::str()[i]))
+            out.str[n++] = Fmt::str()[i];
+    }
+    if (wide_int) {
+        out.str[n++] = 'l';
+        out.str[n++] = 'l';
+    }
+    out.str[n] = s.conv;
+    return out;
+}
+
+// Message buffer. One char over MAX_LOG_LINE_LEN is kept, so truncated message is reported the same way as in C API
+struct writer {
+    char *ptr;
+    char *end;
+
+    void put(const char *str, std::size_t len) {
+        len = len < (std::size_t)(end - ptr) ? len : (std::size_t)(end - ptr);
+        std::memcpy(ptr, str, len);
+        ptr += len;
+    }
+
+    void put_char(char c) {
+        if (ptr < end)
+            *ptr++ = c;
+    }
+
+    void put_uint(unsigned long long value, unsigned base, bool upper) {
+        const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+        char buf[24];
+        int n = 0;
+
+        do {
+            buf[sizeof(buf) - ++n] = digits[value % base];
+            value /= base;
+        } while (value > 0);
+        put(buf + sizeof(buf) - n, n);
+    }
+
+    template <class... Args>
+    void put_printf(const char *spec, Args... args) {
+        int len = std::snprintf(ptr, end - ptr + 1, spec, args...);
+        if (len > 0)
+            ptr += (std::size_t)len < (std::size_t)(end - ptr) ? (std::size_t)len : (std::size_t)(end - ptr);
+    }
+};
+
+template <class T>
+constexpr auto integer_value(const T &arg) {
+    if constexpr (std::is_enum_v<T>)
+        return static_cast<std::underlying_type_t<T>>(arg);
+    else if constexpr (std::is_same_v<T, bool>)
+        return static_cast<int>(arg);
+    else
+        return arg;
+}
+
+// Taken as pointer, so char arrays aren't compared to NULL
+inline const char *null_safe(const char *str) {
+    return str != nullptr ? str : "(null)";
+}
+
+template <class Fmt, std::size_t Pos, class T>
+inline void write_arg(writer &w, const T &arg) {
+    constexpr spec s = parse_spec(Fmt::str(), Pos);
+
+    if constexpr (is_integer_v<T>) {
+        using I = decltype(integer_value(arg));
+        // Unsigned conversions of negative values wrap at argument width, as with printf
+        using U = std::make_unsigned_t<I>;
+        I value = integer_value(arg);
+
+        if constexpr (s.conv == 'c' && s.plain) {
+            w.put_char((char)value);
+        } else if constexpr (s.conv == 'c') {
+            static constexpr printf_spec sp = make_printf_spec<Fmt, Pos>(false);
+            w.put_printf(sp.str, (int)(char)value);
+        } else if constexpr (!s.plain) {
+            static constexpr printf_spec sp = make_printf_spec<Fmt, Pos>(true);
+            if constexpr (s.conv == 'd' || s.conv == 'i')
+                w.put_printf(sp.str, (long long)value);
+            else
+                w.put_printf(sp.str, (unsigned long long)(U)value);
+        } else if constexpr (s.conv == 'd' || s.conv == 'i') {
+            if (value < 0) {
+                w.put_char('-');
+                w.put_uint(0ull - (unsigned long long)(long long)value, 10, false);
+            } else {
+                w.put_uint((unsigned long long)value, 10, false);
+            }
+        } else {
+            w.put_uint((unsigned long long)(U)value, s.conv == 'o' ? 8 : s.conv == 'u' ? 10 : 16, s.conv == 'X');
+        }
+    } else if constexpr (std::is_floating_point_v<T>) {
+        static constexpr printf_spec sp = make_printf_spec<Fmt, Pos>(false);
+        w.put_printf(sp.str, (double)arg);
+    } else if constexpr (s.conv == 's' && s.plain) {
+        if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>) {
+            w.put(arg.data(), arg.size());
+        } else {
+            const char *str = null_safe(arg);
+            w.put(str, std::strlen(str));
+        }
+    } else if constexpr (s.conv == 's') {
+        static constexpr printf_spec sp = make_printf_spec<Fmt, Pos>(false);
+        if constexpr (std::is_same_v<T, std::string>)
+            w.put_printf(sp.str, arg.c_str());
+        else if constexpr (std::is_same_v<T, std::string_view>)
+            w.put_printf(sp.str, std::string(arg).c_str());
+        else
+            w.put_printf(sp.str, null_safe(arg));
+    } else {
+        static constexpr printf_spec sp = make_printf_spec<Fmt, Pos>(false);
+        w.put_printf(sp.str, (const void *)arg);
+    }
+}
+
+// Write format from Pos with remaining arguments
+template <class Fmt, std::size_t Pos>
+inline void write(writer &w) {
+    constexpr std::size_t next = next_spec(Fmt::str(), Pos);
+
+    if constexpr (next > Pos)
+        w.put(Fmt::str() + Pos, next - Pos);
+    if constexpr (Fmt::str()[next] != '\0') {
+        w.put_char('%');
+        write<Fmt, parse_spec(Fmt::str(), next).end>(w);
+    }
+}
+
+template <class Fmt, std::size_t Pos, class T, class... Rest>
+inline void write(writer &w, const T &arg, const Rest &... rest) {
+    constexpr std::size_t next = next_spec(Fmt::str(), Pos);
+    constexpr spec s = parse_spec(Fmt::str(), next);
+
+    if constexpr (next > Pos)
+        w.put(Fmt::str() + Pos, next - Pos);
+    if constexpr (s.conv == '%') {
+        w.put_char('%');
+        write<Fmt, s.end>(w, arg, rest...);
+    } else {
+        write_arg<Fmt, next>(w, arg);
+        write<Fmt, s.end>(w, rest...);
+    }
+}
+
+template <class Fmt, class... Args>
+inline void log(logger *lgg, log_lvl level, uint16_t line, const char *file, const char *func, const Args &... args) {
+    static_assert(checker<Args...>::check(Fmt::str(), 0), "Log format string doesn't match argument types");
+    char msg[MAX_LOG_LINE_LEN + 1];
+    writer w = { msg, msg + MAX_LOG_LINE_LEN };
+
+    if (!log__lvl__enabled(lgg, level))
+        return;
+    write<Fmt, 0>(w, args...);
+    *w.ptr = '\0';
+    print__log__str(lgg, level, line, file, func, msg, w.ptr - msg);
+}
+
+constexpr std::size_t file_name_offset(const char *path) {
+    std::size_t offset = 0;
+
+    for (std::size_t i = 0; path[i] != '\0'; i++) {
+        if (path[i] == P_PATH_SLASH)
+            offset = i + 1;
+    }
+    return offset;
+}
+
+} // namespace detail
+} // namespace yal
+
+#define YAL_LOG(lgg, lvl, fmt, ...) do { \
+        struct yal__fmt { static constexpr const char *str() { return fmt; } }; \
+        ::yal::detail::log<yal__fmt>((lgg), (lvl), (uint16_t)__LINE__, \
+            __FILE__ + std::integral_constant<std::size_t, ::yal::detail::file_name_offset(__FILE__)>::value, \
+            __FUNCTION__, ## __VA_ARGS__); \
+    } while (0)
+
+#endif // YAL_HPP